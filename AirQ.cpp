@@ -6,6 +6,19 @@
 #include "DS1307.h"
 #include "SD.h"
 #include "USBPort.h"
+#include "Sample.h"
+#include "SerCmd.h"
+#include "Frame.h"
+#include "LogXfer.h"
+#include "SoftClock.h"
+#include "Config.h"
+#include "Prof.h"
+#include "Mem.h"
+#include "FixFmt.h"
+#include "Bus.h"
+#include "Uart.h"
+#include "SdLog.h"
+#include "History.h"
 
 /*
  * Pin definition:
@@ -47,89 +60,265 @@
 #define SD_MOSI		MOSI
 #define SD_SCK		SCK
 
-// data
-struct AirQMsg {
-	float temperature;
-	float humidity;
-	int   dust;
-};
-
+#define LOG_FILE	"aqi_log.txt"
 
 /***********************************************
  * Global Control variable
  ***********************************************/
 #define SSPEED 	115200
 
-uint32_t lcd_lu_time = 0u;
-uint32_t lcd_tm_Intv = 1000ul;
-uint32_t lcd_lu_aqdat = 0u;
-uint32_t lcd_ad_Intv = 5000ul;
+/*
+ * The DHT22 read, LCD and SD card keep interrupts off or the loop busy for
+ * milliseconds. With USB enabled they wait until the host is quiet, see
+ * USBPort::quiet(); their timers only restart once they actually ran.
+ */
+#ifdef EN_USB
+#define QUIET()		UsbPort.quiet()
+#else
+#define QUIET()		true
+#endif
+
+/*
+ * Intervals, bands and the DSM501 coefficient live in config.data, see
+ * Config.h.
+ */
+
+/*
+ * Deadband logging: every logIntv the readings are compared against the last
+ * record written, and a new record only goes to the card when one of them
+ * moved out of its band (or the flags changed), or when logMaxSilence has
+ * passed. A reader rebuilds the series by holding each record's values until
+ * the next record; every reconstructed point is then within the band.
+ */
+/*
+ * Snapshot of the readings. The DHT22 part is refreshed every smpIntv and
+ * the DSM501 part whenever it closes a window, each then published on the
+ * bus, see Bus.h. Pushed frames and FT_SAMPLE are served from it.
+ */
+Sample   cur;
+uint32_t lastSmp = 0u;
+uint16_t lastWindows = 0u;
+
+/*
+ * The DSM501 needs a minute after power on; until then its part of the
+ * snapshot is marked SMP_F_WARMING and everything else runs as usual. The
+ * DHT22 is first read once it has settled.
+ */
+#define DSM_WARMUP	60000ul
+#define DHT_SETTLE	2000ul
 
-uint32_t lastLog = 0u;
-uint32_t logIntv = DSM501_MIN_WIN_SPAN;
+uint8_t  warming = true;
+
+/*
+ * The clock as last published with BUS_TIME, looked at every TIME_POLL.
+ */
+#define TIME_POLL	100ul
+
+uint32_t clockSec = 0u;
+uint32_t lastTimePoll = 0u;
+
+/*
+ * Streaming subscription, see FT_SUBSCRIBE.
+ */
+#define STREAM_MIN_INTV	100ul
+
+uint8_t  stream_tag = 0;
+
+#ifdef EN_HIST
+/*
+ * The second LCD line shows the live report and the last hour in turn,
+ * HIST_PAGE ms each; 0 leaves it on the live report.
+ */
+#define HIST_PAGE	5000ul
+
+uint8_t  histPage = false;
+#endif
+
+Sample   lastRec;
+uint32_t lastRecTime = 0u;
+uint8_t  lastRecValid = false;
 
 union _FB {
 	struct {
 		char line1[32]; // time buffer
-		char line2[64]; // display buffer
 	};
 } FB;
 
-uint8_t sd_initialized = false;
+/*
+ * cur rendered for the LCD and for 'r' and the log, see reports().
+ */
+struct Reports {
+	uint16_t seq;		// of the Sample they were made from
+	uint8_t  valid;
+	char     brief[24];
+	char     detail[64];
+} rep;
 
 /***********************************************
  * Components
  ***********************************************/
 DS1307 ds1307;
+SoftClock softClock(ds1307);
 DHT22 dht(DHT22_PIN);
 LiquidCrystal lcd(LCD_RS, LCD_RW, LCD_E, LCD_D4, LCD_D5, LCD_D6, LCD_D7);
 DSM501 dsm501(DSM501_PM10, DSM501_PM25);
 
+void writeRecord(Print &out, const Sample &s);
+SdLog sdLog(SD_CS, LOG_FILE, writeRecord);
+
+#ifdef EN_HIST
+History hist;
+#endif
+
 /***********************************************
  * Report function
  ***********************************************/
-int genReports(char *buf, bool detail = false) {
-	char buf1[16];
-	int n = 0;
+static int32_t toFixed(double v) {
+	if (isnan(v))
+		return 0;	// DSM501 before its first window
+	return (int32_t)(v < 0.0 ? v * 100.0 - 0.5 : v * 100.0 + 0.5);
+}
 
-	dtostrf(dht.readTemperature(), 0, detail ? 2 : 0, buf1);
-	n += sprintf(buf + n, "T:%sC ", buf1);
+/*
+ * Read the DHT22 into s, this is the slow part.
+ */
+void readEnv(Sample &s) {
+	PROF_SCOPE(PROF_SAMPLE);
+
+	float t = dht.readTemperature();
+	float h = dht.readHumidity();
+	if (isnan(t) || isnan(h)) {
+		s.flags |= SMP_F_DHT_ERR;
+		s.temperature = 0;
+		s.humidity = 0;
+	} else {
+		s.flags &= ~SMP_F_DHT_ERR;
+		s.temperature = toFixed(t);
+		s.humidity = toFixed(h);
+	}
+}
 
-	dtostrf(dht.readHumidity(), 0, detail ? 2 : 0, buf1);
-	n += sprintf(buf + n, "H:%s%% ", buf1);
+/*
+ * Take the DSM501 figures of the last window into s.
+ */
+void readPm(Sample &s) {
+	s.pm10 = toFixed(dsm501.getParticalWeight(0));
+	s.pm25 = toFixed(dsm501.getParticalWeight(1));
+	s.aqi = dsm501.getAQI();
+	if (s.aqi < 0) {
+		s.flags |= SMP_F_PM_INIT;
+	} else {
+		s.flags &= ~SMP_F_PM_INIT;
+	}
+}
 
-	if (detail) {
-		dtostrf(dsm501.getParticalWeight(0), 0, 2, buf1);
-		n += sprintf(buf + n, "P10:%sug/m3 ", buf1);
+/*
+ * Mark s as a new snapshot taken at t.
+ */
+void stampSample(Sample &s, uint32_t t) {
+	static uint16_t seq = 0;
 
-		dtostrf(dsm501.getParticalWeight(1), 0, 2, buf1);
-		n += sprintf(buf + n, "P25:%sug/m3 ", buf1);
+	s.seq = ++seq;
+	s.time = t;
+}
+
+/*
+ * Read every sensor once into s.
+ */
+void readSample(Sample &s) {
+	readEnv(s);
+	readPm(s);
+	stampSample(s, softClock.now());
+}
+
+int genReports(char *buf, uint8_t size, const Sample &s, bool detail = false) {
+	uint8_t dec = detail ? 2 : 0;
+	FixFmt f(buf, size);
+
+	f.str_P(PSTR("T:")).fix(s.temperature, 2, dec).str_P(PSTR("C "));
+	f.str_P(PSTR("H:")).fix(s.humidity, 2, dec).str_P(PSTR("% "));
+
+	// no DSM501 figures before the first window after warm-up
+	if (s.flags & (SMP_F_WARMING | SMP_F_PM_INIT)) {
+		f.str_P(detail ? PSTR("warming") : PSTR("warm"));
+		return f.length();
 	}
 
-	n += sprintf(buf + n, "%4d", dsm501.getAQI());
+	if (detail) {
+		f.str_P(PSTR("P10:")).fix(s.pm10, 2, 2).str_P(PSTR("ug/m3 "));
+		f.str_P(PSTR("P25:")).fix(s.pm25, 2, 2).str_P(PSTR("ug/m3 "));
+	}
+
+	f.num(s.aqi, 4);
+
+	return f.length();
+}
 
-	return n;
+/*
+ * Reports of cur, formatted again only once cur is a new snapshot.
+ */
+const Reports &reports() {
+	if (!rep.valid || rep.seq != cur.seq) {
+		genReports(rep.brief, sizeof(rep.brief), cur);
+		genReports(rep.detail, sizeof(rep.detail), cur, true);
+		rep.seq = cur.seq;
+		rep.valid = true;
+	}
+	return rep;
 }
 
 void displayTime() {
+	PROF_SCOPE(PROF_LCD);
 	lcd.setCursor(0, 0);
-	ds1307.makeStr(FB.line1, 31);
+	DS1307::makeStr(FB.line1, sizeof(FB.line1), clockSec);
 	lcd.print(FB.line1);
 }
 
 void displaySdState() {
 	lcd.setCursor(15, 0);
-	if (sd_initialized) {
+	if (sdLog.present()) {
 		lcd.print("*");
 	} else {
 		lcd.print(" ");
 	}
 }
 
+#ifdef EN_HIST
+/*
+ * AQI range over the minutes kept, e.g. "1h AQI 12-345".
+ */
+int genHistory(char *buf, uint8_t size) {
+	FixFmt f(buf, size);
+	HistStat st;
+
+	if (hist.minutes() >= 60) {
+		f.str_P(PSTR("1h"));
+	} else {
+		f.num(hist.minutes()).chr('m');
+	}
+	f.str_P(PSTR(" AQI "));
+	if (hist.query(HIST_AQI, 0, st)) {
+		f.num(st.min).chr('-').num(st.max);
+	} else {
+		f.str_P(PSTR("--"));
+	}
+	return f.length();
+}
+#endif
+
 void displayAirData() {
+	const char *line = reports().brief;
+#ifdef EN_HIST
+	if (histPage) {
+		genHistory(FB.line1, sizeof(FB.line1));
+		line = FB.line1;
+	}
+#endif
 	lcd.setCursor(0, 1);
-	genReports(FB.line2);
-	lcd.print(FB.line2);
+	size_t n = lcd.print(line);
+	while (n++ < 16) {
+		lcd.print(' ');		// clear what a longer line left
+	}
 }
 
 void lcd_ref_line(int line) {
@@ -141,109 +330,351 @@ void lcd_ref_line(int line) {
 	}
 }
 
-void log2Sd() {
-	File dataFile = SD.open("aqi_log.txt", FILE_WRITE);
-
-	if (dataFile) {
-		// since LCD is updating this every sec, we skip this
-//			ds1307.makeStr(buf_t);
-		dataFile.print(FB.line1);
+static bool outOfBand(int32_t a, int32_t b, uint32_t band) {
+	return (uint32_t)(a > b ? a - b : b - a) > band;
+}
 
-		dataFile.print(" "); // Delimiter
+/*
+ * Whether s has to be written, see logDeadband.
+ */
+bool logDue(const Sample &s, uint32_t now) {
+	if (!config.data.logDeadband || !lastRecValid)
+		return true;
+
+	if (now - lastRecTime >= config.data.logMaxSilence)
+		return true;
+
+	return s.flags != lastRec.flags ||
+		outOfBand(s.temperature, lastRec.temperature, config.data.logDbTemp) ||
+		outOfBand(s.humidity, lastRec.humidity, config.data.logDbHumi) ||
+		outOfBand(s.pm10, lastRec.pm10, config.data.logDbPm) ||
+		outOfBand(s.pm25, lastRec.pm25, config.data.logDbPm) ||
+		outOfBand(s.aqi, lastRec.aqi, config.data.logDbAqi);
+}
 
-		// log more detail info
-		genReports(FB.line2, true);
-		dataFile.println(FB.line2);
+/*
+ * One log line: the time of the snapshot and the detailed report.
+ */
+void writeRecord(Print &out, const Sample &s) {
+	DS1307::makeStr(FB.line1, sizeof(FB.line1), s.time);
+	out.print(FB.line1);
 
-		dataFile.close();
+	out.print(" "); // Delimiter
 
-		sd_initialized = true;
+	// log more detail info
+	if (s.seq == cur.seq) {
+		out.println(reports().detail);
 	} else {
-		sd_initialized = false;
+		char line[sizeof(rep.detail)];	// queued while the card was out
+		genReports(line, sizeof(line), s, true);
+		out.println(line);
 	}
 }
 
+void log2Sd() {
+	PROF_SCOPE(PROF_LOG);
+	const Sample &s = cur;
+	uint32_t now = millis();
+
+	if (!logDue(s, now))
+		return;
+
+	// queued until the card is back if need be, see SdLog.h
+	sdLog.add(s);
+
+	lastRec = s;
+	lastRecTime = now;
+	lastRecValid = true;
+}
+
 /***********************************************
- * Serial
+ * Sinks
  ***********************************************/
-#define AQI_SER_OK		'O'
-#define AQI_SER_ERROR 	'E'
-#define AQI_SER_EOP		' '
+static bool quiet() {
+	return QUIET();
+}
 
-uint8_t getch() {
-	while(!Serial.available());
-	return Serial.read();
+/*
+ * A whole frame fits in the TX buffer, so sending it will not wait.
+ */
+static bool frameFits() {
+	return CONSOLE_FITS(FRM_ENC_MAX + 2);
 }
 
-void fill(uint8_t* buff, int n) {
-	for (int x = 0; x < n; x++) {
-		buff[x] = getch();
-	}
+void showTime(uint8_t topics) {
+	lcd_ref_line(1);
 }
 
-bool ch_sync() {
-	if (AQI_SER_EOP != getch()) {
-		Serial.print(AQI_SER_ERROR);
-		return false;
+void showAirData(uint8_t topics) {
+	lcd_ref_line(2);
+}
+
+void logSample(uint8_t topics) {
+	log2Sd();
+}
+
+/*
+ * Push the snapshot to a subscribed host, see FT_SUBSCRIBE.
+ */
+void streamSample(uint8_t topics) {
+	frameSend(CONSOLE, FT_STREAM | FT_RESP, stream_tag, &cur, sizeof(cur));
+}
+
+#ifdef EN_USB
+void usbSample(uint8_t topics) {
+	UsbPort.setSample(cur);
+}
+#endif
+
+#ifdef EN_HIST
+/*
+ * Readings go into the minute they arrive in, BUS_TIME closes minutes.
+ */
+void histSample(uint8_t topics) {
+	hist.poll(millis());
+	if ((topics & BUS_PM) && !(cur.flags & (SMP_F_WARMING | SMP_F_PM_INIT))) {
+		hist.add(HIST_AQI, cur.aqi);
 	}
-	Serial.print(AQI_SER_OK);
-	return true;
+	if ((topics & BUS_ENV) && !(cur.flags & SMP_F_DHT_ERR)) {
+		hist.add(HIST_TEMP, cur.temperature);
+	}
+}
+
+void flipPage(uint8_t topics) {
+	histPage = !histPage;
+	lcd_ref_line(2);
+}
+#endif
+
+/*
+ * Intervals are set by applyConfig(), and by FT_SUBSCRIBE for the stream.
+ */
+BusSub lcdTimeSub = { BUS_TIME, BUS_COALESCE, 0, quiet, showTime };
+BusSub lcdAirSub = { BUS_PM | BUS_ENV, BUS_COALESCE, 0, quiet, showAirData };
+BusSub logSub = { BUS_PM | BUS_ENV, BUS_COALESCE, 0, quiet, logSample };
+BusSub streamSub = { 0, BUS_COALESCE, 0, frameFits, streamSample };	// off
+#ifdef EN_USB
+BusSub usbSub = { BUS_PM | BUS_ENV, BUS_COALESCE, 0, 0, usbSample };
+#endif
+#ifdef EN_HIST
+BusSub histSub = { BUS_PM | BUS_ENV | BUS_TIME, BUS_COALESCE, 0, 0, histSample };
+BusSub histPageSub = { BUS_TIME, BUS_COALESCE, HIST_PAGE, quiet, flipPage };
+#endif
+
+/***********************************************
+ * Config
+ ***********************************************/
+uint8_t cfgGen = 0;
+
+/*
+ * Push settings that are not read straight from config.data.
+ */
+void applyConfig() {
+	dsm501.setCoeff(config.data.coeff);
+	lcdTimeSub.intv = config.data.lcdTmIntv;
+	lcdAirSub.intv = config.data.lcdAdIntv;
+	logSub.intv = config.data.logIntv;
+	cfgGen = config.generation();
 }
 
+/***********************************************
+ * Serial
+ ***********************************************/
+#define AQI_SER_ERROR	SC_ERROR
+#define AQI_SER_EOP		SC_EOP
+
 int SerBcdParseByte(uint8_t *&p) {
 	int v = (*p++ - '0') << 4;
 	v |= (*p++ - '0');
 	return v;
 }
 
-void procSerial()
+void procSerial(uint8_t cmd, uint8_t *arg, uint8_t len);
+
+const SerCmdSpec serCmds[] = {
+	{ 'C', SC_ARG_TOKEN },
+	{ 'g', SC_ARG_TOKEN },
+	{ 'S', SC_ARG_TOKEN },
+	{ 'T', 12 },
+#ifdef EN_HIST
+	{ 'h', SC_ARG_TOKEN },
+#endif
+	{ 0, 0 },
+};
+
+void procFrame(uint8_t type, uint8_t tag, uint8_t *data, uint8_t len);
+
+SerCmd serCmd(CONSOLE, serCmds, procSerial, procFrame);
+LogXfer logXfer(CONSOLE);
+
+/*
+ * Static RAM of the sketch's own objects for 'm'. Buffers the libraries
+ * keep to themselves (serial rings, the SD block cache) are in "other".
+ */
+const MemItem memItems[] PROGMEM = {
+	{ "FB", sizeof(FB) },
+	{ "samples", sizeof(cur) + sizeof(lastRec) },
+	{ "reports", sizeof(rep) },
+	{ "bus", sizeof(bus) + sizeof(lcdTimeSub) + sizeof(lcdAirSub) +
+			sizeof(logSub) + sizeof(streamSub)
+#ifdef EN_USB
+			+ sizeof(usbSub)
+#endif
+	},
+	{ "ds1307", sizeof(ds1307) },
+	{ "softClock", sizeof(softClock) },
+	{ "dht", sizeof(dht) },
+	{ "lcd", sizeof(lcd) },
+	{ "dsm501", sizeof(dsm501) },
+	{ "config", sizeof(config) },
+	{ "serCmd", sizeof(serCmd) },
+	{ "logXfer", sizeof(logXfer) },
+	{ "sdLog", sizeof(sdLog) },
+	{ "SD", sizeof(SD) },
+#ifdef EN_PROF
+	{ "prof", sizeof(Prof::stat) },
+#endif
+#ifdef EN_HIST
+	{ "hist", sizeof(hist) + sizeof(histSub) + sizeof(histPageSub) },
+#endif
+	{ "", 0 },
+};
+
+#ifdef EN_HIST
+/*
+ * One line per reading: name minutes min max avg, or just the name and 0
+ * when there was no value.
+ */
+void procHistory(uint8_t n) {
+	static const char names[HIST_METRICS][5] PROGMEM = { "aqi", "temp" };
+	static const uint8_t scale[HIST_METRICS] PROGMEM = { 0, 2 };
+
+	for (uint8_t m = 0; m < HIST_METRICS; m++) {
+		FixFmt f(FB.line1, sizeof(FB.line1));
+		HistStat st;
+		uint8_t sc = pgm_read_byte(&scale[m]);
+
+		f.str_P(names[m]).chr(' ');
+		if (hist.query(m, n, st)) {
+			f.num(st.n).chr(' ');
+			f.fix(st.min, sc, sc).chr(' ');
+			f.fix(st.max, sc, sc).chr(' ');
+			f.fix(st.avg, sc, sc);
+		} else {
+			f.chr('0');
+		}
+		CONSOLE.println(FB.line1);
+	}
+}
+#endif
+
+void procSerial(uint8_t cmd, uint8_t *arg, uint8_t len)
 {
-	uint8_t val = getch();
-	switch(val) {
+	PROF_SCOPE(PROF_SERIAL);
+
+	switch(cmd) {
 	case 'r':
 		ds1307.makeStr(FB.line1, 32);
-		Serial.print(FB.line1);
-		Serial.print(" ");
-		genReports(FB.line2, true);
-		Serial.println(FB.line2);
+		CONSOLE.print(FB.line1);
+		CONSOLE.print(" ");
+		CONSOLE.println(reports().detail);
 		break;
 
 	case 'C':
-		{
-			if (!ch_sync())
-				return;
-
-			dsm501.setCoeff(Serial.parseInt());
-
-			if (!ch_sync())
-				return;
-
+		if (!config.set(CFG_COEFF, atoi((char *)arg))) {
+			CONSOLE.println(AQI_SER_ERROR);
 			break;
 		}
+		applyConfig();
+		break;
+
 	case 'c':
-		Serial.print("Current DSM501 COEFF:");
-		Serial.println(dsm501.getCoeff());
+		CONSOLE.print("Current DSM501 COEFF:");
+		CONSOLE.println(dsm501.getCoeff());
 		break;
 
+	case 'S':
+		{
+			// <id>=<value>
+			char *eq = strchr((char *)arg, '=');
+			if (!eq || !config.set(atoi((char *)arg), strtoul(eq + 1, NULL, 10))) {
+				CONSOLE.println(AQI_SER_ERROR);
+				break;
+			}
+			applyConfig();
+		}
+		// fall through
+	case 'g':
+		{
+			uint32_t v;
+			uint8_t id = atoi((char *)arg);
+			if (!config.get(id, v)) {
+				CONSOLE.println(AQI_SER_ERROR);
+				break;
+			}
+			CONSOLE.print(id);
+			CONSOLE.print('=');
+			CONSOLE.println(v);
+			break;
+		}
+
 #ifdef DEBUG
 	case 'd':
 		dsm501.debug();
 		break;
 #endif
 
-	case 'T':
+	case 'q':
+		CONSOLE.print("edge_drops ");
+		CONSOLE.println(dsm501.getEdgeDrops());
+		CONSOLE.print("sd_backlog ");
+		CONSOLE.println(sdLog.backlog());
+		CONSOLE.print("sd_drops ");
+		CONSOLE.println(sdLog.drops());
+#ifdef EN_UART
+		CONSOLE.print("rx_drops ");
+		CONSOLE.println(Uart0.rxDrops());
+#endif
+		CONSOLE.print(AQI_SER_EOP);
+		break;
+
+	case 'm':
+		Mem::report(CONSOLE, memItems);
+		CONSOLE.print(AQI_SER_EOP);
+		break;
+
+#ifdef EN_HIST
+	case 'h':
 		{
-			if (!ch_sync())
-				return;
+			// <minutes>, 0 for all that are kept
+			char *end;
+			long n = strtol((char *)arg, &end, 10);
+			if (*end || n < 0 || n > HIST_LEN) {
+				CONSOLE.println(AQI_SER_ERROR);
+				break;
+			}
+			procHistory(n);
+			CONSOLE.print(AQI_SER_EOP);
+			break;
+		}
+#endif
 
-			uint8_t buf[12];
-			int Y, M, D, h, m, s;
+#ifdef EN_PROF
+	case 'p':
+		Prof::dump(CONSOLE);
+		CONSOLE.print(AQI_SER_EOP);
+		break;
+
+	case 'P':
+		Prof::reset();
+		break;
+#endif
 
-			fill(buf, 12);
-			if (!ch_sync())
-				return;
+	case 'T':
+		{
+			int Y, M, D, h, m, s;
 
-			uint8_t *p = buf;
+			uint8_t *p = arg;
 			Y = SerBcdParseByte(p);
 			M = SerBcdParseByte(p);
 			D = SerBcdParseByte(p);
@@ -252,64 +683,254 @@ void procSerial()
 			s = SerBcdParseByte(p);
 
 			ds1307.setDateTimeBCD(Y, M, D, h, m, s);
+			softClock.set(ds1307.toEpoch());
 
 			ds1307.makeStr(FB.line1, 32);
-			Serial.println(FB.line1);
-			Serial.print(AQI_SER_EOP);
+			CONSOLE.println(FB.line1);
+			CONSOLE.print(AQI_SER_EOP);
 
 			break;
 		}
 	} // end of switch
 }
 
+void replyFrame(uint8_t type, uint8_t tag, const void *data, uint8_t len) {
+	frameSend(CONSOLE, type | FT_RESP, tag, data, len);
+}
+
+void replyError(uint8_t tag, uint8_t err) {
+	replyFrame(FT_ERROR, tag, &err, 1);
+}
+
+void procFrame(uint8_t type, uint8_t tag, uint8_t *data, uint8_t len)
+{
+	PROF_SCOPE(PROF_SERIAL);
+
+	switch(type) {
+	case FT_PING:
+		replyFrame(type, tag, data, len);
+		break;
+
+	case FT_SAMPLE:
+		replyFrame(type, tag, &cur, sizeof(cur));
+		break;
+
+	case FT_SUBSCRIBE:
+		{
+			uint32_t intv;	// 0 = on each DSM501 window
+			if (len != sizeof(intv)) {
+				replyError(tag, FE_LENGTH);
+				break;
+			}
+			memcpy(&intv, data, sizeof(intv));
+			if (intv && intv < STREAM_MIN_INTV) {
+				intv = STREAM_MIN_INTV;
+			}
+			stream_tag = tag;
+			streamSub.topics = intv ? BUS_PM | BUS_ENV | BUS_TIME : BUS_PM;
+			streamSub.intv = intv;
+			streamSub.pending = 0;
+			streamSub.last = millis();
+			replyFrame(type, tag, &intv, sizeof(intv));
+			break;
+		}
+
+	case FT_UNSUBSCRIBE:
+		streamSub.topics = 0;
+		streamSub.pending = 0;
+		replyFrame(type, tag, NULL, 0);
+		break;
+
+	case FT_SET_COEFF:
+		if (len != 1) {
+			replyError(tag, FE_LENGTH);
+			break;
+		}
+		if (!config.set(CFG_COEFF, data[0])) {
+			replyError(tag, FE_RANGE);
+			break;
+		}
+		applyConfig();
+		// fall through
+	case FT_GET_COEFF:
+		{
+			uint8_t coeff = dsm501.getCoeff();
+			replyFrame(type, tag, &coeff, 1);
+			break;
+		}
+
+	case FT_SET_TIME:
+		{
+			uint32_t t;
+			if (len != sizeof(t)) {
+				replyError(tag, FE_LENGTH);
+				break;
+			}
+			memcpy(&t, data, sizeof(t));
+			softClock.set(t);
+		}
+		// fall through
+	case FT_GET_TIME:
+		{
+			uint32_t t = softClock.now();
+			replyFrame(type, tag, &t, sizeof(t));
+			break;
+		}
+
+	case FT_CFG_SET:
+	case FT_CFG_GET:
+		{
+			CfgValue cv;
+			if (len != (type == FT_CFG_SET ? sizeof(cv) : 1)) {
+				replyError(tag, FE_LENGTH);
+				break;
+			}
+			memcpy(&cv, data, len);
+			if (type == FT_CFG_SET) {
+				if (!config.set(cv.id, cv.value)) {
+					replyError(tag, FE_RANGE);
+					break;
+				}
+				applyConfig();
+			}
+			uint32_t v;
+			if (!config.get(cv.id, v)) {
+				replyError(tag, FE_RANGE);
+				break;
+			}
+			cv.value = v;
+			replyFrame(type, tag, &cv, sizeof(cv));
+			break;
+		}
+
+	case FT_TIME_SYNC:
+		{
+			TimeSync ts;
+			softClock.now(ts.t2);
+			if (len != sizeof(ts.t1)) {
+				replyError(tag, FE_LENGTH);
+				break;
+			}
+			memcpy(&ts.t1, data, sizeof(ts.t1));
+			softClock.now(ts.t3);
+			replyFrame(type, tag, &ts, sizeof(ts));
+			break;
+		}
+
+	case FT_TIME_ADJ:
+		{
+			TimeAdj adj;
+			TimeAdjResp resp;
+			if (len != sizeof(adj)) {
+				replyError(tag, FE_LENGTH);
+				break;
+			}
+			memcpy(&adj, data, sizeof(adj));
+			softClock.adjust(adj.adj, adj.rtt);
+			resp.drift = softClock.getDrift();
+			resp.offset = softClock.getOffset();
+			replyFrame(type, tag, &resp, sizeof(resp));
+			break;
+		}
+
+	case FT_LOG_READ:
+		{
+			LogReadReq req;
+			LogReadResp resp;
+			if (len != sizeof(req)) {
+				replyError(tag, FE_LENGTH);
+				break;
+			}
+			memcpy(&req, data, sizeof(req));
+			uint8_t err = logXfer.start(LOG_FILE, tag, req, resp);
+			if (err) {
+				replyError(tag, err);
+				break;
+			}
+			replyFrame(type, tag, &resp, sizeof(resp));
+			break;
+		}
+
+	case FT_LOG_ACK:
+		{
+			uint32_t offset;
+			if (len != sizeof(offset)) {
+				replyError(tag, FE_LENGTH);
+				break;
+			}
+			memcpy(&offset, data, sizeof(offset));
+			logXfer.ack(offset);
+			break;
+		}
+
+	case FT_LOG_ABORT:
+		logXfer.abort();
+		replyFrame(type, tag, NULL, 0);
+		break;
+
+	default:
+		replyError(tag, FE_UNKNOWN);
+		break;
+	}
+}
+
+
 /***********************************************
  * Setup
  ***********************************************/
 void setup() {
+#ifdef EN_PROF
+	Prof::begin();
+#endif
+	config.begin();
+
 	// Initialize DSM501
 	dsm501.begin();
+	applyConfig();
 
 	// Initialize DS
 	ds1307.begin();
+	softClock.begin();
 
 	// LCD
 	lcd.begin(16, 2);
 	lcd.noAutoscroll();
 
 	// SD
-	pinMode(SD_CS, OUTPUT);
-	if (SD.begin(SD_CS)) {
-		sd_initialized = true;
-	} else {
-		sd_initialized = false;
-	}
+	sdLog.begin();
 
 	// Serial
-	Serial.begin(SSPEED);
+	CONSOLE.begin(SSPEED);
 
 #ifdef EN_USB
 	// USB
-	UsbPort.begin();
+	UsbPort.begin(LOG_FILE);
 #endif
 
 	lcd.setCursor(0, 1);
 	lcd.print("Initializing...");
 
-	// wait 60s for DSM to warm up
-	for (uint32_t now = millis(); now < 60000ul; now = millis()) {
-		lcd_ref_line(1);
-		delay(10);
-
-		if (Serial.available())
-			procSerial();
+	// the first snapshot comes once the DHT22 has settled
+	cur.flags = SMP_F_WARMING | SMP_F_PM_INIT;
+	cur.aqi = -1;
+	lastSmp = DHT_SETTLE - config.data.smpIntv;
+	clockSec = softClock.now();
 
+	bus.subscribe(lcdTimeSub);
+	bus.subscribe(lcdAirSub);
+	bus.subscribe(logSub);
+	bus.subscribe(streamSub);
 #ifdef EN_USB
-		UsbPort.poll();
+	bus.subscribe(usbSub);
 #endif
+#ifdef EN_HIST
+	hist.begin(millis());
+	bus.subscribe(histSub);
+	if (HIST_PAGE) {
+		bus.subscribe(histPageSub);
 	}
-
-	// Need to reset counter here...
-	dsm501.reset();
+#endif
+	bus.publish(BUS_TIME);
 }
 
 
@@ -317,6 +938,8 @@ void setup() {
  * Main Loop
  ***********************************************/
 void loop() {
+	PROF_SCOPE(PROF_LOOP);
+
 	// call dsm501 to handle updates.
 	dsm501.update();
 
@@ -325,31 +948,69 @@ void loop() {
 	UsbPort.poll();
 #endif
 
-	if (Serial) {
-		if (Serial.available()) {
-			procSerial();
+	if (CONSOLE) {
+		serCmd.poll();
+		if (frameFits()) {
+			logXfer.poll();
 		}
 	} // Serial
 
+	softClock.poll();
+
+	// settings changed over USB, or not yet written back
+	if (config.generation() != cfgGen) {
+		applyConfig();
+	}
+	config.poll();
+
 	uint32_t now = millis();
+
 	/*
-	 * Update LCD every seconds
+	 * Producers: the DSM501 part of the snapshot when a window closed after
+	 * warm-up, the DHT22 part when it is due, and the clock once it moved
+	 * on.
 	 */
-	if (now - lcd_lu_time > lcd_tm_Intv) {
-		lcd_ref_line(1);
-		lcd_lu_time = now;
+	uint8_t topics = 0;
+	if (warming) {
+		if (now >= DSM_WARMUP) {
+			// measure from here on; SMP_F_PM_INIT holds until a window closes
+			dsm501.reset();
+			lastWindows = dsm501.getWindows();
+			cur.flags &= ~SMP_F_WARMING;
+			warming = false;
+		}
+	} else if (dsm501.getWindows() != lastWindows) {
+		readPm(cur);
+		lastWindows = dsm501.getWindows();
+		topics |= BUS_PM;
+	}
+
+	if (now - lastSmp > config.data.smpIntv && QUIET()) {
+		readEnv(cur);
+		lastSmp = now;
+		topics |= BUS_ENV;
 	}
 
-	if (now - lcd_lu_aqdat > lcd_ad_Intv) {
-		lcd_ref_line(2);
-		lcd_lu_aqdat = now;
+	if (now - lastTimePoll >= TIME_POLL) {
+		uint32_t t = softClock.now();
+		if (t != clockSec) {
+			clockSec = t;
+			topics |= BUS_TIME;
+		}
+		lastTimePoll = now;
+	}
+
+	if (topics & (BUS_PM | BUS_ENV)) {
+		stampSample(cur, softClock.now());
 	}
+	bus.publish(topics);
 
 	/*
-	 * Log data to SD card if possible.
+	 * LCD, SD card, serial stream and USB, each at its own pace.
 	 */
-	if (sd_initialized && now - lastLog > logIntv) {
-		log2Sd();
-		lastLog = now;
+	bus.poll(now);
+
+	if (sdLog.probeDue(now) && QUIET()) {
+		sdLog.probe(now);
 	}
 }
@@ -0,0 +1,44 @@
+/*
+ * Bus.cpp
+ *
+ *  See Bus.h.
+ */
+
+#include "Bus.h"
+
+Bus bus;
+
+Bus::Bus() : _subs(0) {
+}
+
+void Bus::subscribe(BusSub &sub) {
+	sub.pending = 0;
+	sub.last = millis() - sub.intv;
+	sub.next = _subs;
+	_subs = &sub;
+}
+
+void Bus::publish(uint8_t topics) {
+	for (BusSub *s = _subs; s; s = s->next) {
+		s->pending |= topics & s->topics;
+	}
+}
+
+void Bus::poll(uint32_t now) {
+	for (BusSub *s = _subs; s; s = s->next) {
+		if (!s->pending || now - s->last < s->intv)
+			continue;
+
+		if (s->ready && !s->ready()) {
+			if (s->policy == BUS_DROP) {
+				s->pending = 0;
+			}
+			continue;
+		}
+
+		uint8_t topics = s->pending;
+		s->pending = 0;
+		s->last = now;
+		s->deliver(topics);
+	}
+}
@@ -0,0 +1,58 @@
+/*
+ * Bus.h
+ *
+ *  Publish/subscribe between the sensors and the sinks. Publishers update
+ *  their part of the shared snapshot once and publish its topic; each
+ *  subscriber says which topics it wants, how often at most, and whether
+ *  it can take a delivery right now.
+ *
+ *  Topics a subscriber has not seen yet are kept as pending bits, so a
+ *  subscriber that is held back by its interval or by ready() gets one
+ *  delivery with everything that changed in the meantime (BUS_COALESCE).
+ *  With BUS_DROP, what arrives while it is not ready is forgotten instead.
+ *  Either way, a subscriber never causes a sensor to be read.
+ */
+
+#ifndef BUS_H_
+#define BUS_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#define BUS_PM		0x01	// DSM501 closed a window
+#define BUS_ENV		0x02	// DHT22 was read
+#define BUS_TIME	0x04	// the clock moved to a new second
+
+#define BUS_COALESCE	0x00
+#define BUS_DROP		0x01
+
+struct BusSub {
+	uint8_t  topics;		// BUS_* wanted
+	uint8_t  policy;		// BUS_COALESCE or BUS_DROP
+	uint32_t intv;			// ms, at least this far apart
+	bool   (*ready)();		// 0 = always
+	void   (*deliver)(uint8_t topics);
+
+	// kept by Bus
+	uint8_t  pending;
+	uint32_t last;
+	BusSub  *next;
+};
+
+class Bus {
+public:
+	Bus();
+
+	void subscribe(BusSub &sub);
+	void publish(uint8_t topics);
+	void poll(uint32_t now);	// called in the loop function
+
+protected:
+	BusSub *_subs;
+};
+
+extern Bus bus;
+
+#endif /* BUS_H_ */
@@ -0,0 +1,147 @@
+/*
+ * Config.cpp
+ *
+ *  Settings kept in EEPROM, see Config.h.
+ */
+
+#include "Config.h"
+#include "DSM501.h"
+#include "EEStore.h"
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+Config config;
+
+struct CfgField {
+	uint8_t  off;
+	uint8_t  size;
+	uint32_t min;
+	uint32_t max;
+};
+
+#define CFG_FIELD(f, lo, hi)	\
+	{ offsetof(ConfigData, f), sizeof(((ConfigData *)0)->f), lo, hi }
+
+/*
+ * Anything set() takes has to be safe to run with: no zero divisors or
+ * intervals, nothing that does not fit the field.
+ */
+static const CfgField cfgFields[CFG_FIELDS] PROGMEM = {
+	CFG_FIELD(coeff, 1, 255),
+	CFG_FIELD(lcdTmIntv, 100ul, _mS_By_S(3600ul)),
+	CFG_FIELD(lcdAdIntv, 100ul, _mS_By_S(3600ul)),
+	CFG_FIELD(logIntv, 1000ul, _mS_By_S(86400ul)),
+	CFG_FIELD(logDeadband, 0, 1),
+	CFG_FIELD(logDbTemp, 0, 10000u),			// 100C
+	CFG_FIELD(logDbHumi, 0, 10000u),			// 100%
+	CFG_FIELD(logDbPm, 0, 100000ul),			// 1000ug/m3
+	CFG_FIELD(logDbAqi, 0, 500u),
+	CFG_FIELD(logMaxSilence, 1000ul, _mS_By_S(86400ul)),
+	CFG_FIELD(smpIntv, 2000ul, _mS_By_S(3600ul)),	// DHT22 minimum
+};
+
+Config::Config() {
+	defaults();
+	_dirty = false;
+	_pending = false;
+	_ticket = 0;
+	_gen = 0;
+	_changed = 0;
+}
+
+void Config::defaults() {
+	data.version = CFG_VERSION;
+	data.coeff = 1;
+	data.lcdTmIntv = 1000ul;
+	data.lcdAdIntv = 5000ul;
+	data.logIntv = DSM501_MIN_WIN_SPAN;
+	data.logDeadband = true;
+	data.logDbTemp = 50u;		// 0.50C
+	data.logDbHumi = 200u;		// 2.00%
+	data.logDbPm = 500ul;		// 5.00ug/m3
+	data.logDbAqi = 5u;
+	data.logMaxSilence = _mS_By_S(900ul);	// 15 mins
+	data.smpIntv = 2000ul;		// DHT22 can not be read faster
+}
+
+uint16_t Config::crc(const ConfigData &d) {
+	const uint8_t *p = (const uint8_t *)&d;
+	uint16_t crc = 0xffff;
+	for (uint8_t i = 0; i < offsetof(ConfigData, crc); i++) {
+		crc = _crc_ccitt_update(crc, p[i]);
+	}
+	return crc;
+}
+
+/*
+ * Every field within its range, for a block from an older build that let
+ * anything in.
+ */
+bool Config::inRange() const {
+	for (uint8_t id = 0; id < CFG_FIELDS; id++) {
+		CfgField f;
+		uint32_t v;
+		memcpy_P(&f, &cfgFields[id], sizeof(f));
+		get(id, v);
+		if (v < f.min || v > f.max)
+			return false;
+	}
+	return true;
+}
+
+void Config::begin() {
+	eeprom_read_block(&data, (uint8_t *)0 + CFG_BASE, sizeof(data));
+	if (data.version != CFG_VERSION || data.crc != crc(data) || !inRange()) {
+		defaults();
+	}
+	_gen++;
+}
+
+bool Config::get(uint8_t id, uint32_t &v) const {
+	if (id >= CFG_FIELDS)
+		return false;
+
+	CfgField f;
+	memcpy_P(&f, &cfgFields[id], sizeof(f));
+	v = 0;
+	memcpy(&v, (const uint8_t *)&data + f.off, f.size);
+	return true;
+}
+
+bool Config::set(uint8_t id, uint32_t v) {
+	if (id >= CFG_FIELDS)
+		return false;
+
+	CfgField f;
+	memcpy_P(&f, &cfgFields[id], sizeof(f));
+	if (v < f.min || v > f.max)
+		return false;
+
+	memcpy((uint8_t *)&data + f.off, &v, f.size);
+	_dirty = true;
+	_changed = millis();
+	_gen++;
+	return true;
+}
+
+void Config::poll() {
+	// tickets come round again, drop ours as soon as it is done
+	if (_pending && EEAsync::done(_ticket)) {
+		_pending = false;
+	}
+
+	if (!_dirty || millis() - _changed < CFG_WB_DELAY)
+		return;
+
+	// _wb is the source of a write still going on
+	if (_pending)
+		return;
+
+	_wb = data;
+	_wb.crc = crc(_wb);
+	if (EEAsync::write(CFG_BASE, &_wb, sizeof(_wb), &_ticket)) {
+		_pending = true;
+		_dirty = false;
+	}
+}
@@ -0,0 +1,90 @@
+/*
+ * Config.h
+ *
+ *  Settings kept in EEPROM, versioned and CRC checked.
+ *
+ *  The block is read once in begin(); anything that does not check out
+ *  falls back to the defaults. Changes go to the RAM copy and are written
+ *  back by poll() once they have settled for CFG_WB_DELAY, in the
+ *  background through EEAsync, which only touches the bytes that changed.
+ *  Fields can be read and set by id from the serial port and USB; each has
+ *  a range, and set() refuses values outside it.
+ */
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#define CFG_VERSION		1
+#define CFG_BASE		0x220	// EEPROM, after the USB report slots
+#define CFG_WB_DELAY	5000ul
+
+enum ConfigId {
+	CFG_COEFF,			// DSM501 coefficient
+	CFG_LCD_TM_INTV,	// ms, LCD time line
+	CFG_LCD_AD_INTV,	// ms, LCD air data line
+	CFG_LOG_INTV,		// ms, SD log evaluation
+	CFG_LOG_DEADBAND,	// 0 = log every CFG_LOG_INTV
+	CFG_LOG_DB_TEMP,	// 0.01C
+	CFG_LOG_DB_HUMI,	// 0.01%
+	CFG_LOG_DB_PM,		// 0.01ug/m3
+	CFG_LOG_DB_AQI,
+	CFG_LOG_MAX_SILENCE,	// ms
+	CFG_SMP_INTV,		// ms, sample refresh
+	CFG_FIELDS,
+};
+
+struct __attribute__((packed)) ConfigData {
+	uint8_t  version;
+	uint8_t  coeff;
+	uint32_t lcdTmIntv;
+	uint32_t lcdAdIntv;
+	uint32_t logIntv;
+	uint8_t  logDeadband;
+	uint16_t logDbTemp;
+	uint16_t logDbHumi;
+	uint32_t logDbPm;
+	uint16_t logDbAqi;
+	uint32_t logMaxSilence;
+	uint32_t smpIntv;
+	uint16_t crc;
+};
+
+class Config {
+public:
+	Config();
+	void begin();
+	void poll();	// called in the loop function
+
+	bool get(uint8_t id, uint32_t &v) const;
+	bool set(uint8_t id, uint32_t v);	// false for no such id or out of range
+
+	// bumped on every set(), to tell when settings have to be applied
+	uint8_t generation() const {
+		return _gen;
+	}
+
+public:
+	ConfigData data;
+
+protected:
+	void defaults();
+	bool inRange() const;
+	static uint16_t crc(const ConfigData &d);
+
+private:
+	ConfigData _wb;		// copy being written back
+	uint8_t	_dirty;
+	uint8_t	_pending;
+	uint8_t	_ticket;
+	uint8_t	_gen;
+	uint32_t _changed;
+};
+
+extern Config config;
+
+#endif /* CONFIG_H_ */
@@ -6,6 +6,8 @@
  */
 
 #include "DS1307.h"
+#include "FixFmt.h"
+#include "Uart.h"
 
 #define DS_SEC_OFF	0
 #define DS_MIN_OFF	1
@@ -42,8 +44,8 @@ void DS1307::setDateTimeBCD(int Y, int M, int d, int h, int m, int s) {
 
 #ifdef DEBUG
 void DS1307::debug() {
-	char buf[32];
-	Serial.println("--- DS1307 BEGIN ---");
+	char buf[8];
+	CONSOLE.println("--- DS1307 BEGIN ---");
 	// reset internal address
 	Wire.beginTransmission(DS1307_I2C_ADDR);
 	Wire.write(0);
@@ -51,8 +53,9 @@ void DS1307::debug() {
 
 	Wire.requestFrom(DS1307_I2C_ADDR, 7);
 	for (int i = 0; i < 7; ) {
-		sprintf(buf, "%02x: %02x", i++, Wire.read());
-		Serial.println(buf);
+		FixFmt f(buf, sizeof(buf));
+		f.hex(i++).str_P(PSTR(": ")).hex(Wire.read());
+		CONSOLE.println(buf);
 	}
 }
 #endif
@@ -69,6 +72,24 @@ void DS1307::readRawData(byte* buf) {
 	}
 }
 
+void DS1307::writeRam(uint8_t addr, const void* buf, uint8_t n) {
+	Wire.beginTransmission(DS1307_I2C_ADDR);
+	Wire.write(DS1307_RAM_BASE + addr);
+	Wire.write((const uint8_t*)buf, n);
+	Wire.endTransmission();
+}
+
+void DS1307::readRam(uint8_t addr, void* buf, uint8_t n) {
+	Wire.beginTransmission(DS1307_I2C_ADDR);
+	Wire.write(DS1307_RAM_BASE + addr);
+	Wire.endTransmission();
+
+	Wire.requestFrom(DS1307_I2C_ADDR, (int)n);
+	for (uint8_t i = 0; i < n; ) {
+		((uint8_t*)buf)[i++] = Wire.read();
+	}
+}
+
 void DS1307::updateDateTime() {
 	byte buf[7];
 	readRawData(buf);
@@ -77,9 +98,98 @@ void DS1307::updateDateTime() {
 
 int DS1307::makeStr(char* buf, int n) {
 	updateDateTime();
-	return snprintf(buf, n, "%02d/%02d %02d:%02d:%02d%s",
-			month, day, hour, min, sec,
-			(m == M_24) ? "" : (m == M_AM) ? "A" : "P");
+	FixFmt f(buf, n);
+	f.num(month, 2, '0').chr('/').num(day, 2, '0').chr(' ');
+	f.num(hour, 2, '0').chr(':').num(min, 2, '0').chr(':').num(sec, 2, '0');
+	if (m != M_24) {
+		f.chr(m == M_AM ? 'A' : 'P');
+	}
+	return f.length();
+}
+
+static const uint8_t monthDays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+static uint8_t daysOfMonth(int y, int M) {
+	return (M == 2 && (y & 3) == 0) ? 29 : monthDays[M - 1];
+}
+
+/*
+ * The DS1307 only covers 2000-2099, so every 4th year is a leap year.
+ */
+uint32_t DS1307::toEpoch() const {
+	int h = hour;
+	if (m == M_PM && h != 12) {
+		h += 12;
+	} else if (m == M_AM && h == 12) {
+		h = 0;
+	}
+
+	uint16_t days = year * 365u + (year + 3) / 4;
+	for (int i = 1; i < month; i++) {
+		days += daysOfMonth(year, i);
+	}
+	days += day - 1;
+
+	return ((uint32_t)days * 24ul + h) * 3600ul + min * 60u + sec;
+}
+
+uint32_t DS1307::getEpoch() {
+	updateDateTime();
+	return toEpoch();
+}
+
+#define Byte_BCD(x)	((((x) / 10) << 4) | ((x) % 10))
+
+struct DsDate {
+	uint8_t Y, M, D, h, m, s;
+};
+
+static void splitEpoch(uint32_t t, DsDate &d) {
+	d.s = t % 60ul;
+	t /= 60ul;
+	d.m = t % 60ul;
+	t /= 60ul;
+	d.h = t % 24ul;
+	uint16_t days = t / 24ul;
+
+	uint8_t y = 0;
+	for (;;) {
+		uint16_t n = (y & 3) ? 365u : 366u;
+		if (days < n)
+			break;
+		days -= n;
+		y++;
+	}
+
+	uint8_t M = 1;
+	while (days >= daysOfMonth(y, M)) {
+		days -= daysOfMonth(y, M);
+		M++;
+	}
+
+	d.Y = y;
+	d.M = M;
+	d.D = days + 1;
+}
+
+void DS1307::setEpoch(uint32_t t) {
+	DsDate d;
+	splitEpoch(t, d);
+	setDateTimeBCD(Byte_BCD(d.Y), Byte_BCD(d.M), Byte_BCD(d.D),
+			Byte_BCD(d.h), Byte_BCD(d.m), Byte_BCD(d.s));
+}
+
+/*
+ * Same format as makeStr(), 24h, from a time kept elsewhere.
+ */
+int DS1307::makeStr(char* buf, int n, uint32_t t) {
+	DsDate d;
+	splitEpoch(t, d);
+
+	FixFmt f(buf, n);
+	f.num(d.M, 2, '0').chr('/').num(d.D, 2, '0').chr(' ');
+	f.num(d.h, 2, '0').chr(':').num(d.m, 2, '0').chr(':').num(d.s, 2, '0');
+	return f.length();
 }
 
 #define BCD_Byte(x, h, l) (((x) & (l)) + (((x) & ((h) << 4)) >> 4) * 10)
@@ -16,6 +16,8 @@
 #include <Wire.h>
 
 #define DS1307_I2C_ADDR 0x68
+#define DS1307_RAM_BASE	0x08	// 56 bytes of battery backed RAM
+#define DS1307_RAM_SIZE	56
 
 class DS1307 {
 public:
@@ -32,11 +34,18 @@ public:
 	void setDateTimeBCD(int y, int M, int d, int h, int m, int s);
 	void updateDateTime();
 	int makeStr(char* buf, int n);
+	static int makeStr(char* buf, int n, uint32_t t);
+
+	// seconds since 2000-01-01 00:00:00
+	uint32_t getEpoch();
+	void setEpoch(uint32_t t);
+	uint32_t toEpoch() const;
 
 	void debug();
 
-//	void store(int addr, uint8_t v);
-//	void retrieve(int addr, uint8_t v);
+	// addr is relative to DS1307_RAM_BASE
+	void writeRam(uint8_t addr, const void* buf, uint8_t n);
+	void readRam(uint8_t addr, void* buf, uint8_t n);
 
 public:
 	int sec;
@@ -1,9 +1,28 @@
 #include "DSM501.h"
+#include "Uart.h"
 #include <avr/interrupt.h>
 
 
 uint8_t dsm501_coeff = 1;
 
+#ifdef DSM501_PCINT
+static DSM501 *dsmIrq;
+
+/*
+ * V-USB allows interrupts off for no more than 25 cycles, less than the
+ * prologue of a handler that calls edge(), so let them in right away.
+ * Entry clears the pin change flag; mask it until the levels are queued,
+ * and a change meanwhile comes in once it is unmasked. One in the few
+ * cycles before the mask runs to the end first, so edge() never overlaps.
+ */
+ISR(PCINT1_vect, ISR_NOBLOCK) {
+	PCICR &= ~_BV(PCIE1);
+	dsmIrq->edge();
+	cli();
+	PCICR |= _BV(PCIE1);
+}
+#endif
+
 DSM501::DSM501(int pin10, int pin25) {
 	_pin[PM10_IDX] = pin10;
 	_pin[PM25_IDX] = pin25;
@@ -19,6 +38,9 @@ DSM501::DSM501(int pin10, int pin25) {
 		memset(_saf_ent[i], 0, SAF_WIN_MAX * sizeof(uint32_t));
 		_saf_idx[i] = 0;
 	}
+
+	_windows = 0;
+	_level = _BV(PM10_IDX) | _BV(PM25_IDX);	// idle high
 }
 
 
@@ -30,12 +52,35 @@ void DSM501::begin() {
 
 	_win_start[PM25_IDX] = millis();
 	pinMode(_pin[PM25_IDX], INPUT);
+
+#ifdef DSM501_PCINT
+	dsmIrq = this;
+	for (int i = 0; i < 2; i++) {
+		_in[i] = portInputRegister(digitalPinToPort(_pin[i]));
+		_mask[i] = digitalPinToBitMask(_pin[i]);
+		*digitalPinToPCMSK(_pin[i]) |= _BV(digitalPinToPCMSKbit(_pin[i]));
+		PCICR |= _BV(digitalPinToPCICRbit(_pin[i]));
+	}
+#endif
 }
 
 
+/*
+ * Forget everything measured so far and start new windows now. The window
+ * count keeps going.
+ */
 void DSM501::reset() {
-	_win_start[PM10_IDX] = millis();
-	_win_start[PM25_IDX] = millis();
+	for (int i = 0; i < 2; i++) {
+		_win_start[i] = millis();
+		_low_total[i] = 0;
+		_state[i] = S_Idle;
+		_sig_start[i] = 0;
+		_lastLowRatio[i] = NAN;
+
+		_saf_sum[i] = 0;
+		memset(_saf_ent[i], 0, SAF_WIN_MAX * sizeof(uint32_t));
+		_saf_idx[i] = 0;
+	}
 }
 
 uint8_t DSM501::setCoeff(uint8_t coeff) {
@@ -44,35 +89,74 @@ uint8_t DSM501::setCoeff(uint8_t coeff) {
 }
 
 
+/*
+ * Queue the pin levels if they changed since the last call. A change that
+ * does not fit is queued by a later call, once the ring has room again.
+ */
+void DSM501::edge() {
+	uint8_t level = 0;
+	for (int i = 0; i < 2; i++) {
+#ifdef DSM501_PCINT
+		if (*_in[i] & _mask[i])
+#else
+		if (digitalRead(_pin[i]) == HIGH)
+#endif
+			level |= _BV(i);
+	}
+
+	if (level != _level) {
+		DsmEdge e = { (uint16_t)millis(), level };
+		if (_edges.push(e)) {
+			_level = level;
+		}
+	}
+}
+
+
 void DSM501::update() {
-	if (_state[PM10_IDX] == S_Idle && digitalRead(_pin[PM10_IDX]) == LOW) {
-		signal_begin(PM10_IDX);
-	} else if (_state[PM10_IDX] == S_Start && digitalRead(_pin[PM10_IDX]) == HIGH) {
-		signal_end(PM10_IDX);
+#ifndef DSM501_PCINT
+	edge();
+#endif
+
+	// both windows are started together, close them together
+	uint32_t now = millis();
+
+	DsmEdge e;
+	while (_edges.pop(e)) {
+		// may be a little after now if it came in meanwhile
+		uint32_t t = now - (int16_t)((uint16_t)now - e.ms);
+
+		for (int i = 0; i < 2; i++) {
+			bool low = !(e.level & _BV(i));
+			if (_state[i] == S_Idle && low) {
+				signal_begin(i, t);
+			} else if (_state[i] == S_Start && !low) {
+				signal_end(i, t);
+			}
+		}
 	}
 
-	if (_state[PM25_IDX] == S_Idle && digitalRead(_pin[PM25_IDX]) == LOW) {
-		signal_begin(PM25_IDX);
-	} else if (_state[PM25_IDX] == S_Start && digitalRead(_pin[PM25_IDX]) == HIGH) {
-		signal_end(PM25_IDX);
+	if (now - _win_start[PM10_IDX] >= DSM501_MIN_WIN_SPAN) {
+		window_end(PM10_IDX, now);
+		window_end(PM25_IDX, now);
+		_windows++;
 	}
 }
 
 
-void DSM501::signal_begin(int i) {
-	if (millis() >= _win_start[i]) {
-		_sig_start[i] = millis();
+void DSM501::signal_begin(int i, uint32_t t) {
+	if (t >= _win_start[i]) {
+		_sig_start[i] = t;
 		_state[i] = S_Start;
 	}
 }
 
 
-void DSM501::signal_end(int i) {
-	uint32_t now = millis();
+void DSM501::signal_end(int i, uint32_t t) {
 	if (_sig_start[i]) { // we had a signal, and
-		if ((now - _sig_start[i]) <= DSM501_MAX_SIG_SPAN &&
-			(now - _sig_start[i]) >= DSM501_MIN_SIG_SPAN) {	// this signal is not bouncing.
-			_low_total[i] += now - _sig_start[i];
+		if ((t - _sig_start[i]) <= DSM501_MAX_SIG_SPAN &&
+			(t - _sig_start[i]) >= DSM501_MIN_SIG_SPAN) {	// this signal is not bouncing.
+			_low_total[i] += t - _sig_start[i];
 		}
 		_sig_start[i] = 0;
 	}
@@ -80,34 +164,27 @@ void DSM501::signal_end(int i) {
 }
 
 
-/*
- * Only return the stabilized ratio
- */
-double DSM501::getLowRatio(int i) {
-	uint32_t now = millis();
-	uint32_t span = now - _win_start[i];
+void DSM501::window_end(int i, uint32_t now) {
+	int idx = (++_saf_idx[i]) % SAF_WIN_MAX;
+	_saf_sum[i] -= _saf_ent[i][idx];
+	_saf_ent[i][idx] = _low_total[i];
+	_saf_sum[i] += _low_total[i];
 
-	// special case if the device run too long, the millis() counter wrap back.
-	if (now < _win_start[i]) {
-		span = DSM501_MIN_WIN_SPAN;
+	if (_saf_idx[i] < SAF_WIN_MAX) {
+		_lastLowRatio[i] = (double)_saf_sum[i] * 100.0 / (double)(DSM501_MIN_WIN_SPAN * _saf_idx[i]);
+	} else {
+		_lastLowRatio[i] = (double)_saf_sum[i] * 100.0 / (double)(DSM501_MIN_WIN_SPAN * SAF_WIN_MAX);
 	}
 
-	if (span >= DSM501_MIN_WIN_SPAN) {
-		int idx = (++_saf_idx[i]) % SAF_WIN_MAX;
-		_saf_sum[i] -= _saf_ent[i][idx];
-		_saf_ent[i][idx] = _low_total[i];
-		_saf_sum[i] += _low_total[i];
-
-		if (_saf_idx[i] < SAF_WIN_MAX) {
-			_lastLowRatio[i] = (double)_saf_sum[i] * 100.0 / (double)(DSM501_MIN_WIN_SPAN * _saf_idx[i]);
-		} else {
-			_lastLowRatio[i] = (double)_saf_sum[i] * 100.0 / (double)(DSM501_MIN_WIN_SPAN * SAF_WIN_MAX);
-		}
+	_win_start[i] = now;
+	_low_total[i] = 0;
+}
 
-		_win_start[i] = now;
-		_low_total[i] = 0;
-	}
 
+/*
+ * Only return the stabilized ratio, windows are closed by update()
+ */
+double DSM501::getLowRatio(int i) {
 	return _lastLowRatio[i] / (double)_coeff;
 }
 
@@ -155,16 +232,16 @@ int DSM501::getAQI() {
 #ifdef DEBUG
 void DSM501::debug(void)
 {
-	Serial.println("--- DSM501 BEGIN ---");
+	CONSOLE.println("--- DSM501 BEGIN ---");
 
-	Serial.println(_win_start[PM10_IDX]);
-	Serial.println(DSM501_MIN_WIN_SPAN);
-	Serial.println(DSM501_MIN_WIN_SPAN - (millis() - _win_start[PM10_IDX]));
+	CONSOLE.println(_win_start[PM10_IDX]);
+	CONSOLE.println(DSM501_MIN_WIN_SPAN);
+	CONSOLE.println(DSM501_MIN_WIN_SPAN - (millis() - _win_start[PM10_IDX]));
 
-	Serial.println(getLowRatio(PM10_IDX));
-	Serial.println(getLowRatio(PM25_IDX));
+	CONSOLE.println(getLowRatio(PM10_IDX));
+	CONSOLE.println(getLowRatio(PM25_IDX));
 
-	Serial.println(_low_total[PM10_IDX]);
-	Serial.println(_low_total[PM25_IDX]);
+	CONSOLE.println(_low_total[PM10_IDX]);
+	CONSOLE.println(_low_total[PM25_IDX]);
 }
 #endif
@@ -6,6 +6,8 @@
  #include "WProgram.h"
 #endif
 
+#include "Ring.h"
+
 #define _mS_By_S(x)	((x) * 1000ul)
 #define _S_By_S(x) 	(x)
 
@@ -21,6 +23,22 @@
 
 #define SAF_WIN_MAX 10	// mins
 
+#define DSM501_EDGES	16	// pin changes queued for update(), see Ring.h
+
+/*
+ * Pin changes are taken on PCINT1 where the core says how to, so both pins
+ * have to be on A0-A5 then. Elsewhere update() polls the pins and queues
+ * what it sees the same way.
+ */
+#if defined(PCINT1_vect) && defined(digitalPinToPCMSK)
+#define DSM501_PCINT
+#endif
+
+struct DsmEdge {
+	uint16_t ms;		// low half of millis()
+	uint8_t  level;		// bit i is the level of channel i
+};
+
 enum State {
 	S_Idle,
 	S_Start,
@@ -44,9 +62,22 @@ public:
 	}
 	uint8_t setCoeff(uint8_t coeff);
 
+	// pin changes lost because update() did not keep up
+	uint16_t getEdgeDrops() const {
+		return _edges.drops();
+	}
+
+	void edge();	// the pins may have changed, from the interrupt
+
+	// bumped each time a measuring window closes and the ratios change
+	uint16_t getWindows() const {
+		return _windows;
+	}
+
 protected:
-	void signal_begin(int i);
-	void signal_end(int i);
+	void signal_begin(int i, uint32_t t);
+	void signal_end(int i, uint32_t t);
+	void window_end(int i, uint32_t now);
 
 private:
 	int 	_pin[2];
@@ -62,6 +93,15 @@ private:
 
 	uint8_t	_coeff;
 	double 	_lastLowRatio[2];
+	uint16_t _windows;
+
+	// written by edge() only
+	Ring<DsmEdge, DSM501_EDGES> _edges;
+	uint8_t _level;
+#ifdef DSM501_PCINT
+	volatile uint8_t *_in[2];
+	uint8_t _mask[2];
+#endif
 };
 
 #endif
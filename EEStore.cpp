@@ -0,0 +1,156 @@
+/*
+ * EEStore.cpp
+ *
+ *  Background EEPROM writes and a wear leveled block, see EEStore.h.
+ */
+
+#include "EEStore.h"
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+
+struct EEJob {
+	uint16_t addr;
+	const uint8_t *src;
+	uint8_t len;
+};
+
+static EEJob	eeJobs[EEA_QUEUE];
+static volatile uint8_t eeHead;	// job being written
+static volatile uint8_t eeTail;	// next free entry
+static uint8_t	eePos;			// byte within the head job
+
+bool EEAsync::write(uint16_t addr, const void *src, uint8_t len, uint8_t *ticket) {
+	uint8_t tail = eeTail;
+	if ((uint8_t)(tail - eeHead) >= EEA_QUEUE)
+		return false;
+
+	EEJob &j = eeJobs[tail & (EEA_QUEUE - 1)];
+	j.addr = addr;
+	j.src = (const uint8_t *)src;
+	j.len = len;
+	eeTail = tail + 1;
+	if (ticket) {
+		*ticket = tail;
+	}
+
+	EECR |= _BV(EERIE);	// fires right away if the EEPROM is idle
+	return true;
+}
+
+/*
+ * Done once the job is no longer queued. Ticket numbers come round again
+ * after 256 jobs, so holders drop a ticket once they have seen it done.
+ */
+bool EEAsync::done(uint8_t ticket) {
+	uint8_t head = eeHead;
+	return (uint8_t)(ticket - head) >= (uint8_t)(eeTail - head);
+}
+
+bool EEAsync::busy() {
+	return eeHead != eeTail;
+}
+
+/*
+ * Start the next byte that differs, or switch the interrupt off once the
+ * queue is empty. Runs with interrupts enabled, see the vector below.
+ */
+void EEAsync::service() {
+	while (eeHead != eeTail) {
+		EEJob &j = eeJobs[eeHead & (EEA_QUEUE - 1)];
+		while (eePos < j.len) {
+			uint16_t addr = j.addr + eePos;
+			uint8_t v = j.src[eePos++];
+			if (eeprom_read_byte((uint8_t *)0 + addr) != v) {
+				cli();
+				EEAR = addr;
+				EEDR = v;
+				EECR |= _BV(EEMPE);
+				EECR |= _BV(EEPE);
+				EECR |= _BV(EERIE);
+				sei();
+				return;
+			}
+		}
+		eePos = 0;
+		eeHead = eeHead + 1;
+	}
+}
+
+/*
+ * V-USB allows interrupts off for no more than 25 cycles, less than the
+ * prologue of a handler that calls service(). EE_READY is level triggered,
+ * so a naked stub masks it and lets the others in before jumping to the
+ * real handler; service() unmasks it again when it starts a byte.
+ */
+#ifdef __AVR__
+extern "C" void __vector_ee_ready(void) __attribute__((signal, used));
+
+ISR(EE_READY_vect, ISR_NAKED) {
+	__asm__ __volatile__ (
+		"cbi %0, %1"	"\n\t"
+		"sei"			"\n\t"
+		"jmp __vector_ee_ready"
+		:: "I" (_SFR_IO_ADDR(EECR)), "I" (EERIE));
+}
+
+extern "C" void __vector_ee_ready(void) {
+	EEAsync::service();
+}
+#else
+ISR(EE_READY_vect) {
+	EECR &= ~_BV(EERIE);
+	EEAsync::service();
+}
+#endif
+
+
+EEBlock::EEBlock(uint16_t base, uint8_t size, uint8_t slots) :
+	_base(base), _size(size), _slots(slots), _cur(0) {
+	_hdr[0] = _hdr[1] = 0;
+	_pending = false;
+	_ticket = 0;
+}
+
+void EEBlock::begin() {
+	uint8_t best = 0;
+	bool found = false;
+
+	for (uint8_t i = 0; i < _slots; i++) {
+		uint8_t h[EEB_HDR];
+		eeprom_read_block(h, (uint8_t *)0 + slotAddr(i), EEB_HDR);
+		if (h[1] != (uint8_t)~h[0])
+			continue;	// never written, or cut short
+		if (!found || (int8_t)(h[0] - best) > 0) {
+			best = h[0];
+			_cur = i;
+			found = true;
+		}
+	}
+	_hdr[0] = found ? best : 0xff;
+}
+
+void EEBlock::read(uint8_t off, void *dst, uint8_t len) {
+	eeprom_read_block(dst, (uint8_t *)0 + slotAddr(_cur) + EEB_HDR + off, len);
+}
+
+bool EEBlock::busy() {
+	if (_pending && EEAsync::done(_ticket)) {
+		_pending = false;
+	}
+	return _pending;
+}
+
+bool EEBlock::commit(const uint8_t *data) {
+	if (busy() || (uint8_t)(eeTail - eeHead) > EEA_QUEUE - 2)
+		return false;
+
+	uint8_t next = (_cur + 1) % _slots;
+	_hdr[0]++;
+	_hdr[1] = ~_hdr[0];
+
+	EEAsync::write(slotAddr(next) + EEB_HDR, data, _size);
+	EEAsync::write(slotAddr(next), _hdr, EEB_HDR, &_ticket);
+	_pending = true;
+	_cur = next;
+	return true;
+}
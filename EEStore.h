@@ -0,0 +1,68 @@
+/*
+ * EEStore.h
+ *
+ *  Background EEPROM writes and a wear leveled block on top of them.
+ *
+ *  EEAsync queues (address, RAM source, length) jobs and commits them one
+ *  byte per EEPROM-ready interrupt, skipping bytes that already hold the
+ *  right value. A write costs the caller a few microseconds instead of
+ *  3.3ms per byte. The source has to stay untouched until busy() clears.
+ *
+ *  EEBlock keeps one block in a ring of slots, each led by a header
+ *  { seq, ~seq }. A commit goes to the slot after the newest one and its
+ *  header is written last, so a write cut short by a reset leaves the
+ *  previous copy in charge, and the writes are spread over all slots.
+ */
+
+#ifndef EESTORE_H_
+#define EESTORE_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#define EEA_QUEUE	4	// jobs, power of two
+
+class EEAsync {
+public:
+	// ticket, if given, is for done()
+	static bool write(uint16_t addr, const void *src, uint8_t len, uint8_t *ticket = 0);
+	static bool done(uint8_t ticket);
+	static bool busy();
+
+	static void service();	// EEPROM-ready interrupt
+};
+
+#define EEB_HDR		2
+
+class EEBlock {
+public:
+	EEBlock(uint16_t base, uint8_t size, uint8_t slots);
+	void begin();	// find the newest copy
+
+	void read(uint8_t off, void *dst, uint8_t len);
+	bool commit(const uint8_t *data);	// data has to stay valid while busy()
+
+	bool busy();
+
+	uint16_t end() const {	// first address after the slots
+		return _base + (uint16_t)(EEB_HDR + _size) * _slots;
+	}
+
+protected:
+	uint16_t slotAddr(uint8_t slot) const {
+		return _base + (uint16_t)(EEB_HDR + _size) * slot;
+	}
+
+private:
+	uint16_t _base;
+	uint8_t	_size;
+	uint8_t	_slots;
+	uint8_t	_cur;		// slot with the newest copy
+	uint8_t	_hdr[EEB_HDR];	// header being written
+	uint8_t	_pending;
+	uint8_t	_ticket;	// of the header write
+};
+
+#endif /* EESTORE_H_ */
@@ -0,0 +1,103 @@
+/*
+ * FixFmt.cpp
+ *
+ *  See FixFmt.h.
+ */
+
+#include "FixFmt.h"
+
+static const uint32_t fixPow10[] PROGMEM = {
+	1ul, 10ul, 100ul, 1000ul, 10000ul, 100000ul,
+};
+
+FixFmt::FixFmt(char *buf, uint8_t size) : _buf(buf), _size(size), _len(0) {
+	if (size) {
+		buf[0] = 0;
+	}
+}
+
+FixFmt &FixFmt::chr(char c) {
+	if (_len + 1 < _size) {
+		_buf[_len++] = c;
+		_buf[_len] = 0;
+	}
+	return *this;
+}
+
+FixFmt &FixFmt::str(const char *s) {
+	while (*s) {
+		chr(*s++);
+	}
+	return *this;
+}
+
+FixFmt &FixFmt::str_P(const char *s) {
+	char c;
+	while ((c = pgm_read_byte(s++))) {
+		chr(c);
+	}
+	return *this;
+}
+
+FixFmt &FixFmt::num(int32_t v, uint8_t width, char pad) {
+	char tmp[11];
+	uint8_t n = 0;
+	uint32_t u = v < 0 ? -(uint32_t)v : v;
+
+	// 16 bit division is much cheaper on the AVR, use it once u fits
+	while (u > 0xffff) {
+		tmp[n++] = '0' + u % 10;
+		u /= 10;
+	}
+	uint16_t w = u;
+	do {
+		tmp[n++] = '0' + w % 10;
+		w /= 10;
+	} while (w);
+
+	uint8_t len = n + (v < 0);
+	if (v < 0 && pad == '0') {
+		chr('-');
+	}
+	for (; width > len; width--) {
+		chr(pad);
+	}
+	if (v < 0 && pad != '0') {
+		chr('-');
+	}
+	while (n) {
+		chr(tmp[--n]);
+	}
+	return *this;
+}
+
+FixFmt &FixFmt::fix(int32_t v, uint8_t scale, uint8_t dec) {
+	if (dec > scale) {
+		dec = scale;
+	}
+
+	bool neg = v < 0;
+	uint32_t u = neg ? -(uint32_t)v : v;
+	if (dec < scale) {
+		uint32_t d = pgm_read_dword(&fixPow10[scale - dec]);
+		u = (u + d / 2) / d;
+	}
+
+	uint32_t div = pgm_read_dword(&fixPow10[dec]);
+	uint32_t ip = u / div;
+	if (neg && u) {
+		chr('-');
+	}
+	num(ip);
+	if (dec) {
+		chr('.');
+		num(u - ip * div, dec, '0');
+	}
+	return *this;
+}
+
+FixFmt &FixFmt::hex(uint8_t v) {
+	static const char digits[] PROGMEM = "0123456789abcdef";
+	chr(pgm_read_byte(&digits[v >> 4]));
+	return chr(pgm_read_byte(&digits[v & 0xf]));
+}
@@ -0,0 +1,48 @@
+/*
+ * FixFmt.h
+ *
+ *  Small formatter for the report and clock strings, instead of sprintf and
+ *  dtostrf. Numbers are fixed point integers, e.g. 2345 with 2 decimals is
+ *  23.45, the way Sample keeps them. Output stops at the end of the buffer
+ *  and is always terminated.
+ *
+ *  	FixFmt f(buf, sizeof(buf));
+ *  	f.str_P(PSTR("T:")).fix(s.temperature, 2, 1).chr('C');
+ */
+
+#ifndef FIXFMT_H_
+#define FIXFMT_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+class FixFmt {
+public:
+	FixFmt(char *buf, uint8_t size);
+
+	FixFmt &chr(char c);
+	FixFmt &str(const char *s);
+	FixFmt &str_P(const char *s);
+
+	// decimal, right aligned to width with pad
+	FixFmt &num(int32_t v, uint8_t width = 0, char pad = ' ');
+
+	// v has scale decimals, printed with dec of them, rounded half away from 0
+	FixFmt &fix(int32_t v, uint8_t scale, uint8_t dec);
+
+	// two hex digits
+	FixFmt &hex(uint8_t v);
+
+	uint8_t length() const {
+		return _len;
+	}
+
+private:
+	char *_buf;
+	uint8_t _size;
+	uint8_t _len;
+};
+
+#endif /* FIXFMT_H_ */
@@ -0,0 +1,94 @@
+/*
+ * Frame.cpp
+ *
+ *  Binary framing for the serial port, see Frame.h.
+ */
+
+#include "Frame.h"
+#include <util/crc16.h>
+
+int cobsDecode(uint8_t *buf, uint8_t len) {
+	uint8_t *out = buf;
+	const uint8_t *p = buf;
+	const uint8_t *end = buf + len;
+
+	while (p < end) {
+		uint8_t code = *p++;
+		if (code == 0 || code - 1 > end - p)
+			return -1;
+
+		for (uint8_t i = 1; i < code; i++) {
+			*out++ = *p++;
+		}
+		if (code != 0xff && p < end) {
+			*out++ = 0;
+		}
+	}
+	return out - buf;
+}
+
+void cobsWrite(Print &port, const uint8_t *src, uint8_t len) {
+	for (;;) {
+		uint8_t run = 0;
+		while (run < len && run < 254 && src[run])
+			run++;
+
+		port.write(run + 1);
+		port.write(src, run);
+		src += run;
+		len -= run;
+
+		if (run == 254) {
+			if (len == 0)
+				break;
+		} else {
+			if (len == 0)
+				break;
+			// skip the zero the block stands for
+			src++;
+			len--;
+		}
+	}
+}
+
+uint16_t frameCrc(const uint8_t *buf, uint8_t len) {
+	uint16_t crc = 0xffff;
+	while (len--) {
+		crc = _crc_ccitt_update(crc, *buf++);
+	}
+	return crc;
+}
+
+int frameOpen(uint8_t *buf, uint8_t len) {
+	int n = cobsDecode(buf, len);
+	if (n < 4)
+		return -1;
+
+	n -= 2;
+	uint16_t crc = buf[n] | (buf[n + 1] << 8);
+	if (crc != frameCrc(buf, n))
+		return -1;
+
+	return n - 2;
+}
+
+bool frameSend(Print &port, uint8_t type, uint8_t tag, const void *data, uint8_t len) {
+	uint8_t buf[FRM_MAX];
+
+	if (len > FRM_PAYLOAD)
+		return false;
+
+	buf[0] = type;
+	buf[1] = tag;
+	memcpy(buf + 2, data, len);
+	len += 2;
+
+	uint16_t crc = frameCrc(buf, len);
+	buf[len++] = crc & 0xff;
+	buf[len++] = crc >> 8;
+
+	port.write((uint8_t)FRM_DELIM);
+	cobsWrite(port, buf, len);
+	port.write((uint8_t)FRM_DELIM);
+	return true;
+}
@@ -0,0 +1,75 @@
+/*
+ * Frame.h
+ *
+ *  Binary framing for the serial port, next to the text commands.
+ *
+ *  A frame is
+ *  	0x00 COBS(type tag payload crc_lo crc_hi) 0x00
+ *  where crc is _crc_ccitt_update() over type, tag and payload starting from
+ *  0xffff. COBS keeps 0x00 out of the body, so a 0x00 always marks a frame
+ *  boundary and can never be taken for a text command. Responses echo the
+ *  tag of the request and carry its type with FT_RESP set.
+ */
+
+#ifndef FRAME_H_
+#define FRAME_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#define FRM_DELIM	0x00
+#define FRM_MAX		48					// decoded frame, header and crc included
+#define FRM_PAYLOAD	(FRM_MAX - 4)		// largest payload
+#define FRM_ENC_MAX	(FRM_MAX + 2)		// worst case COBS size of a frame
+
+#define FT_RESP		0x80
+
+enum FrameType {
+	FT_PING			= 0x01,	// -> echoes the payload
+	FT_SAMPLE		= 0x02,	// -> Sample
+	FT_GET_COEFF	= 0x03,	// -> uint8_t coeff
+	FT_SET_COEFF	= 0x04,	// uint8_t coeff -> uint8_t coeff
+	FT_GET_TIME		= 0x05,	// -> uint32_t epoch
+	FT_SET_TIME		= 0x06,	// uint32_t epoch -> uint32_t epoch
+	FT_SUBSCRIBE	= 0x07,	// uint32_t min period ms, 0 = each DSM501 window -> same
+	FT_UNSUBSCRIBE	= 0x08,	// -> nothing
+	FT_LOG_READ		= 0x09,	// LogReadReq -> LogReadResp, then FT_LOG_DATA
+	FT_LOG_ACK		= 0x0a,	// uint32_t offset received so far -> nothing
+	FT_LOG_ABORT	= 0x0b,	// -> nothing
+	FT_TIME_SYNC	= 0x0c,	// TimeStamp t1 -> TimeSync
+	FT_TIME_ADJ		= 0x0d,	// TimeAdj -> TimeAdjResp
+	FT_CFG_GET		= 0x0e,	// uint8_t id -> CfgValue
+	FT_CFG_SET		= 0x0f,	// CfgValue -> CfgValue
+	FT_STREAM		= 0x10,	// pushed with FT_RESP and the subscribe tag: Sample
+	FT_LOG_DATA		= 0x11,	// pushed with FT_RESP and the read tag: uint32_t offset, data
+	FT_ERROR		= 0x7f,	// -> uint8_t FrameError
+};
+
+enum FrameError {
+	FE_UNKNOWN	= 1,	// type not supported
+	FE_LENGTH	= 2,	// payload too short or too long
+	FE_CRC		= 3,	// frame damaged, nothing was done
+	FE_IO		= 4,	// file missing or unreadable
+	FE_TIMEOUT	= 5,	// the host stopped acknowledging
+	FE_RANGE	= 6,	// no such item, or value out of range
+};
+
+struct __attribute__((packed)) CfgValue {
+	uint8_t  id;		// ConfigId
+	uint32_t value;
+};
+
+int		cobsDecode(uint8_t *buf, uint8_t len);
+void	cobsWrite(Print &port, const uint8_t *src, uint8_t len);
+uint16_t frameCrc(const uint8_t *buf, uint8_t len);
+
+/*
+ * Check and strip a received frame in place. Returns the payload length,
+ * or -1 when the frame is broken.
+ */
+int		frameOpen(uint8_t *buf, uint8_t len);
+bool	frameSend(Print &port, uint8_t type, uint8_t tag, const void *data, uint8_t len);
+
+#endif /* FRAME_H_ */
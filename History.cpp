@@ -0,0 +1,175 @@
+/*
+ * History.cpp
+ *
+ *  See History.h.
+ */
+
+#include "History.h"
+
+#define HIST_SLOTS	(HIST_LEN + 1)	// one more for the total before the window
+
+static uint32_t getSum(const uint8_t *p) {
+	return p[0] | (uint16_t)p[1] << 8 | (uint32_t)p[2] << 16;
+}
+
+static void putSum(uint8_t *p, uint32_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+}
+
+/*
+ * Difference of two 24 bit totals, sign extended.
+ */
+static int32_t sumDiff(const uint8_t *a, const uint8_t *b) {
+	return (int32_t)((getSum(a) - getSum(b)) << 8) >> 8;
+}
+
+static uint8_t slotBack(uint8_t slot, uint8_t n) {
+	return slot >= n ? slot - n : slot + HIST_SLOTS - n;
+}
+
+History::History() : _slot(0), _minutes(0), _start(0) {
+	memset(_s, 0, sizeof(_s));
+}
+
+void History::begin(uint32_t now) {
+	_start = now;
+}
+
+void History::poll(uint32_t now) {
+	while (now - _start >= HIST_MINUTE) {
+		close();
+		_start += HIST_MINUTE;
+	}
+}
+
+void History::add(uint8_t m, int16_t v) {
+	if (m >= HIST_METRICS)
+		return;
+
+	HistSeries &s = _s[m];
+	if (s.accN != 0xff) {
+		s.acc += v;
+		s.accN++;
+	}
+}
+
+int16_t History::value(const HistSeries &s, uint8_t slot) const {
+	return sumDiff(s.sum[slot], s.sum[slotBack(slot, 1)]);
+}
+
+/*
+ * Ring slot of the i-th entry from the front, folded in 16 bits since
+ * head + i goes past 255 for a HIST_LEN over 128.
+ */
+static uint8_t dequeAt(const HistDeque &d, uint8_t i) {
+	uint16_t k = d.head + i;
+	return d.slot[k < HIST_LEN ? k : k - HIST_LEN];
+}
+
+uint8_t History::age(uint8_t slot) const {
+	return _slot >= slot ? _slot - slot : _slot + HIST_SLOTS - slot;
+}
+
+/*
+ * Drop the front entry once it has left the window; closing a minute ages
+ * every entry by one, so at most one goes.
+ */
+void History::expire(HistDeque &d) {
+	if (d.len && age(d.slot[d.head]) >= HIST_LEN) {
+		d.head = d.head + 1 == HIST_LEN ? 0 : d.head + 1;
+		d.len--;
+	}
+}
+
+/*
+ * Append slot, dropping the entries at the back that can no longer be the
+ * extreme of any window.
+ */
+void History::push(const HistSeries &s, HistDeque &d, uint8_t slot, bool rising) {
+	int16_t v = value(s, slot);
+	while (d.len) {
+		int16_t b = value(s, dequeAt(d, d.len - 1));
+		if (rising ? b < v : b > v)
+			break;
+		d.len--;
+	}
+
+	uint16_t tail = d.head + d.len;
+	d.slot[tail < HIST_LEN ? tail : tail - HIST_LEN] = slot;
+	d.len++;
+}
+
+/*
+ * The minute that is over becomes the newest slot. Series without a
+ * reading in it carry their totals over and stay out of the deques.
+ */
+void History::close() {
+	uint8_t prev = _slot;
+	_slot = _slot + 1 == HIST_SLOTS ? 0 : _slot + 1;
+
+	for (uint8_t m = 0; m < HIST_METRICS; m++) {
+		HistSeries &s = _s[m];
+		int32_t v = 0;
+
+		if (s.accN) {
+			v = (s.acc + (s.acc < 0 ? -(s.accN / 2) : s.accN / 2)) / s.accN;
+		}
+		putSum(s.sum[_slot], getSum(s.sum[prev]) + v);
+		s.cnt[_slot] = s.cnt[prev] + (s.accN != 0);
+
+		expire(s.lo);
+		expire(s.hi);
+		if (s.accN) {
+			push(s, s.lo, _slot, true);
+			push(s, s.hi, _slot, false);
+		}
+		s.acc = 0;
+		s.accN = 0;
+	}
+
+	if (_minutes < HIST_LEN) {
+		_minutes++;
+	}
+}
+
+/*
+ * Value of the oldest deque entry within the last n minutes. Ages fall
+ * from the front to the back.
+ */
+int16_t History::extreme(const HistSeries &s, const HistDeque &d, uint8_t n) const {
+	uint8_t lo = 0, hi = d.len - 1;
+
+	while (lo < hi) {
+		uint8_t mid = (lo + hi) / 2;
+		if (age(dequeAt(d, mid)) < n) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	return value(s, dequeAt(d, lo));
+}
+
+bool History::query(uint8_t m, uint8_t n, HistStat &st) const {
+	if (m >= HIST_METRICS)
+		return false;
+
+	if (n == 0 || n > _minutes) {
+		n = _minutes;
+	}
+
+	const HistSeries &s = _s[m];
+	uint8_t base = slotBack(_slot, n);
+	st.n = s.cnt[_slot] - s.cnt[base];
+	if (!st.n)
+		return false;
+
+	int32_t sum = sumDiff(s.sum[_slot], s.sum[base]);
+	st.avg = (sum + (sum < 0 ? -(st.n / 2) : st.n / 2)) / st.n;
+	st.min = extreme(s, s.lo, n);
+	st.max = extreme(s, s.hi, n);
+	return true;
+}
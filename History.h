@@ -0,0 +1,95 @@
+/*
+ * History.h
+ *
+ *  The last HIST_LEN minutes of a few readings, for "what was the peak in
+ *  the last hour" without going to the SD card.
+ *
+ *  Readings are averaged over each minute of millis(). A closed minute is
+ *  kept as a running total and a running count of minutes that had a
+ *  value, so the average over any trailing window is two subtractions.
+ *  Minima and maxima come from monotonic deques of the minutes in the
+ *  window: the oldest entry is the extreme of the whole window, and for a
+ *  shorter one it is the oldest entry young enough, found by bisecting the
+ *  deque (six steps for an hour).
+ *
+ *  Totals are 24 bit and wrap; a window holds at most HIST_LEN int16
+ *  values, so their difference is still exact. A series takes about
+ *  HIST_LEN * 6 bytes of RAM; the sketch only keeps a History with EN_HIST
+ *  defined.
+ */
+
+#ifndef HISTORY_H_
+#define HISTORY_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#define HIST_LEN		60			// minutes, up to 254
+#define HIST_MINUTE		60000ul		// ms
+
+enum HistMetric {
+	HIST_AQI,
+	HIST_TEMP,		// 0.01 C
+	HIST_METRICS
+};
+
+struct HistStat {
+	uint8_t n;		// minutes with a value
+	int16_t min;
+	int16_t max;
+	int16_t avg;
+};
+
+/*
+ * Slots of the series ring, in the order they came in.
+ */
+struct HistDeque {
+	uint8_t slot[HIST_LEN];
+	uint8_t head;
+	uint8_t len;
+};
+
+struct HistSeries {
+	uint8_t sum[HIST_LEN + 1][3];	// running total up to each slot
+	uint8_t cnt[HIST_LEN + 1];		// running count up to each slot
+	HistDeque lo;					// values rising from the front
+	HistDeque hi;					// falling
+	int32_t acc;					// the minute being collected
+	uint8_t accN;
+};
+
+class History {
+public:
+	History();
+	void begin(uint32_t now);
+	void poll(uint32_t now);	// closes the minutes that are over
+
+	// one reading for the current minute
+	void add(uint8_t m, int16_t v);
+
+	// closed minutes kept, up to HIST_LEN
+	uint8_t minutes() const {
+		return _minutes;
+	}
+
+	// the last n closed minutes (all of them for 0), false without a value
+	bool query(uint8_t m, uint8_t n, HistStat &st) const;
+
+protected:
+	void close();
+	int16_t value(const HistSeries &s, uint8_t slot) const;
+	uint8_t age(uint8_t slot) const;
+	int16_t extreme(const HistSeries &s, const HistDeque &d, uint8_t n) const;
+	void expire(HistDeque &d);
+	void push(const HistSeries &s, HistDeque &d, uint8_t slot, bool rising);
+
+private:
+	HistSeries _s[HIST_METRICS];
+	uint8_t  _slot;		// of the newest closed minute
+	uint8_t  _minutes;
+	uint32_t _start;	// of the current minute
+};
+
+#endif /* HISTORY_H_ */
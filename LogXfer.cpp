@@ -0,0 +1,125 @@
+/*
+ * LogXfer.cpp
+ *
+ *  Windowed SD log download, see LogXfer.h.
+ */
+
+#include "LogXfer.h"
+
+LogXfer::LogXfer(Print &port) : _port(port) {
+	_active = false;
+	_tag = 0;
+	_window = 1;
+	_retries = 0;
+	_end = _next = _acked = _last = 0;
+}
+
+/*
+ * Returns 0 or a FrameError.
+ */
+uint8_t LogXfer::start(const char *name, uint8_t tag, const LogReadReq &req, LogReadResp &resp) {
+	if (_active) {
+		_file.close();
+		_active = false;
+	}
+
+	_file = SD.open(name, FILE_READ);
+	if (!_file)
+		return FE_IO;
+
+	uint32_t size = _file.size();
+	uint32_t offset = req.offset < size ? req.offset : size;
+	uint32_t length = size - offset;
+	if (req.length && req.length < length) {
+		length = req.length;
+	}
+
+	if (!_file.seek(offset)) {
+		_file.close();
+		return FE_IO;
+	}
+
+	resp.size = size;
+	resp.offset = offset;
+	resp.length = length;
+
+	_tag = tag;
+	_window = req.window == 0 ? 1 : req.window > LX_WINDOW_MAX ? LX_WINDOW_MAX : req.window;
+	_retries = 0;
+	_end = offset + length;
+	_next = _acked = offset;
+	_last = millis();
+	_active = true;
+	return 0;
+}
+
+void LogXfer::ack(uint32_t offset) {
+	if (!_active || offset <= _acked || offset > _next)
+		return;
+
+	_acked = offset;
+	_retries = 0;
+	_last = millis();
+
+	if (_acked == _end) {
+		finish();
+	}
+}
+
+void LogXfer::abort() {
+	if (_active) {
+		_file.close();
+		_active = false;
+	}
+}
+
+void LogXfer::finish() {
+	frameSend(_port, FT_LOG_DATA | FT_RESP, _tag, &_end, sizeof(_end));
+	abort();
+}
+
+void LogXfer::sendChunk() {
+	uint8_t buf[4 + LX_CHUNK];
+	uint32_t n = _end - _next;
+	if (n > LX_CHUNK) {
+		n = LX_CHUNK;
+	}
+
+	memcpy(buf, &_next, 4);
+	int got = _file.read(buf + 4, n);
+	if (got != (int)n) {
+		uint8_t err = FE_IO;
+		frameSend(_port, FT_ERROR | FT_RESP, _tag, &err, 1);
+		abort();
+		return;
+	}
+
+	frameSend(_port, FT_LOG_DATA | FT_RESP, _tag, buf, 4 + n);
+	_next += n;
+}
+
+void LogXfer::poll() {
+	if (!_active)
+		return;
+
+	uint32_t now = millis();
+	if (_next != _acked && now - _last > LX_TIMEOUT) {
+		if (++_retries > LX_RETRIES) {
+			uint8_t err = FE_TIMEOUT;
+			frameSend(_port, FT_ERROR | FT_RESP, _tag, &err, 1);
+			abort();
+			return;
+		}
+		// go back to what the host has
+		_next = _acked;
+		_file.seek(_next);
+		_last = now;
+	}
+
+	// one chunk per call, the UART is busy for its duration anyway
+	if (_next < _end && _next - _acked < (uint32_t)_window * LX_CHUNK) {
+		sendChunk();
+	} else if (_acked == _end) {
+		finish();
+	}
+}
@@ -0,0 +1,76 @@
+/*
+ * LogXfer.h
+ *
+ *  Streams a byte range of a file on the SD card over the binary serial
+ *  protocol, with a sliding window of unacknowledged chunks.
+ *
+ *  The host sends FT_LOG_READ and gets back the file size and the range
+ *  that will be sent. Chunks then arrive as FT_LOG_DATA frames, each
+ *  carrying its file offset, and the host acknowledges with FT_LOG_ACK and
+ *  the offset it has received up to. At most `window` chunks are in flight;
+ *  when no acknowledgement comes in for LX_TIMEOUT the device goes back to
+ *  the last acknowledged offset. A FT_LOG_DATA without data marks the end.
+ *  An interrupted transfer is resumed with a new FT_LOG_READ starting at
+ *  the last offset the host acknowledged.
+ */
+
+#ifndef LOGXFER_H_
+#define LOGXFER_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "SD.h"
+#include "Frame.h"
+
+#define LX_CHUNK		(FRM_PAYLOAD - 4)	// data bytes per FT_LOG_DATA
+#define LX_WINDOW_MAX	8
+#define LX_TIMEOUT		500ul
+#define LX_RETRIES		5
+
+struct __attribute__((packed)) LogReadReq {
+	uint32_t offset;
+	uint32_t length;	// 0 = up to the end of the file
+	uint8_t  window;	// chunks in flight, 1 - LX_WINDOW_MAX
+};
+
+struct __attribute__((packed)) LogReadResp {
+	uint32_t size;		// whole file
+	uint32_t offset;
+	uint32_t length;	// what will actually be sent
+};
+
+class LogXfer {
+public:
+	LogXfer(Print &port);
+
+	uint8_t start(const char *name, uint8_t tag, const LogReadReq &req, LogReadResp &resp);
+	void ack(uint32_t offset);
+	void abort();
+	void poll();	// called in the loop function
+
+	bool active() const {
+		return _active;
+	}
+
+protected:
+	void sendChunk();
+	void finish();
+
+private:
+	Print	&_port;
+	File	_file;
+	uint8_t	_active;
+	uint8_t	_tag;
+	uint8_t	_window;
+	uint8_t	_retries;
+
+	uint32_t _end;
+	uint32_t _next;		// next offset to send
+	uint32_t _acked;	// everything below is with the host
+	uint32_t _last;		// time of the last progress
+};
+
+#endif /* LOGXFER_H_ */
@@ -0,0 +1,130 @@
+/*
+ * Mem.cpp
+ *
+ *  See Mem.h. All figures are 0 off the AVR.
+ */
+
+#include "Mem.h"
+
+#ifdef __AVR__
+extern uint8_t __data_start;
+extern uint8_t __data_end;
+extern uint8_t __bss_start;
+extern uint8_t __bss_end;
+extern uint8_t __heap_start;
+extern char *__brkval;
+
+/*
+ * Runs before the stack pointer is set up and r1 is cleared, so plain
+ * assembly, painting from the end of .bss to RAMEND.
+ */
+void memPaint(void) __attribute__((naked, used, section(".init1")));
+
+void memPaint(void) {
+	__asm volatile (
+		"	ldi r30, lo8(__bss_end)\n"
+		"	ldi r31, hi8(__bss_end)\n"
+		"	ldi r24, %0\n"
+		"	ldi r25, hi8(%1)\n"
+		"	rjmp 2f\n"
+		"1:	st Z+, r24\n"
+		"2:	cpi r30, lo8(%1)\n"
+		"	cpc r31, r25\n"
+		"	brlo 1b\n"
+		"	breq 1b\n"
+		:
+		: "i" (MEM_PAINT), "i" (RAMEND));
+}
+
+static uint8_t *heapTop() {
+	return __brkval ? (uint8_t *)__brkval : &__heap_start;
+}
+#endif
+
+uint16_t Mem::dataSize() {
+#ifdef __AVR__
+	return &__data_end - &__data_start;
+#else
+	return 0;
+#endif
+}
+
+uint16_t Mem::bssSize() {
+#ifdef __AVR__
+	return &__bss_end - &__bss_start;
+#else
+	return 0;
+#endif
+}
+
+uint16_t Mem::heapSize() {
+#ifdef __AVR__
+	return heapTop() - &__heap_start;
+#else
+	return 0;
+#endif
+}
+
+uint16_t Mem::freeMin() {
+#ifdef __AVR__
+	uint16_t n = 0;
+	for (uint8_t *p = heapTop(); p <= (uint8_t *)RAMEND && *p == MEM_PAINT; p++) {
+		n++;
+	}
+	return n;
+#else
+	return 0;
+#endif
+}
+
+uint16_t Mem::stackMax() {
+#ifdef __AVR__
+	return (uint8_t *)RAMEND + 1 - heapTop() - freeMin();
+#else
+	return 0;
+#endif
+}
+
+uint16_t Mem::freeNow() {
+#ifdef __AVR__
+	return (uint8_t *)SP - heapTop();
+#else
+	return 0;
+#endif
+}
+
+void Mem::report(Print &out, const MemItem *items) {
+	static const MemItem sum[] PROGMEM = {
+		{ "data", 0 }, { "bss", 0 }, { "heap", 0 },
+		{ "stack_max", 0 }, { "free", 0 }, { "free_min", 0 },
+	};
+	uint16_t v[] = {
+		dataSize(), bssSize(), heapSize(), stackMax(), freeNow(), freeMin(),
+	};
+
+	uint16_t listed = 0;
+	for (uint8_t pass = 0; pass < 2; pass++) {
+		const MemItem *it = pass ? items : sum;
+		uint8_t n = pass ? 0xff : sizeof(v) / sizeof(v[0]);
+
+		for (uint8_t i = 0; i < n; i++, it++) {
+			MemItem m;
+			memcpy_P(&m, it, sizeof(m));
+			if (!m.name[0])
+				break;
+
+			if (pass) {
+				listed += m.size;
+			} else {
+				m.size = v[i];
+			}
+			out.print(m.name);
+			out.print(' ');
+			out.println(m.size);
+		}
+	}
+
+	uint16_t statics = dataSize() + bssSize();
+	out.print("other ");
+	out.println(statics > listed ? statics - listed : 0);
+}
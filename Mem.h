@@ -0,0 +1,42 @@
+/*
+ * Mem.h
+ *
+ *  RAM budget. Everything between the end of .bss and the top of RAM is
+ *  filled with MEM_PAINT before main() runs, so the deepest the stack ever
+ *  got can be found later by looking for the first byte that changed.
+ *
+ *  The sizes of the big static objects come from a table the sketch keeps,
+ *  see report(); the rest of .data and .bss (core buffers, statics inside
+ *  modules) is listed as one figure.
+ */
+
+#ifndef MEM_H_
+#define MEM_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#define MEM_PAINT	0xc5
+#define MEM_NAME	10
+
+struct MemItem {
+	char name[MEM_NAME];
+	uint16_t size;
+};
+
+class Mem {
+public:
+	static uint16_t dataSize();
+	static uint16_t bssSize();
+	static uint16_t heapSize();		// in use by malloc()
+	static uint16_t stackMax();		// high water mark since boot
+	static uint16_t freeNow();		// between heap and stack, right now
+	static uint16_t freeMin();		// never touched since boot
+
+	// "name bytes" lines; items is in PROGMEM, ended by an empty name
+	static void report(Print &out, const MemItem *items);
+};
+
+#endif /* MEM_H_ */
@@ -0,0 +1,94 @@
+/*
+ * Prof.cpp
+ *
+ *  See Prof.h.
+ */
+
+#include "Prof.h"
+#include <avr/interrupt.h>
+
+ProfStat Prof::stat[PROF_SECTIONS];
+
+static const char profNames[PROF_SECTIONS][7] PROGMEM = {
+	"loop", "sample", "lcd", "log", "serial",
+};
+
+#ifdef __AVR__
+static volatile uint16_t profHigh;
+
+/*
+ * Let V-USB in right away, the count is only read with interrupts off.
+ */
+ISR(TIMER1_OVF_vect, ISR_NOBLOCK) {
+	profHigh++;
+}
+#endif
+
+void Prof::begin() {
+#ifdef __AVR__
+	TCCR1A = 0;				// normal mode, OC1A/OC1B disconnected
+	TCCR1B = _BV(CS10);		// clk/1
+	TCNT1 = 0;
+	TIFR1 = _BV(TOV1);
+	TIMSK1 = _BV(TOIE1);
+#endif
+	reset();
+}
+
+uint32_t Prof::now() {
+#ifdef __AVR__
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t lo = TCNT1;
+	uint16_t hi = profHigh;
+	if ((TIFR1 & _BV(TOV1)) && lo < 0x8000) {
+		hi++;	// wrapped, but the interrupt has not run yet
+	}
+	SREG = sreg;
+	return ((uint32_t)hi << 16) | lo;
+#else
+	return micros() * (F_CPU / 1000000ul);
+#endif
+}
+
+void Prof::add(uint8_t id, uint32_t cycles) {
+	ProfStat &s = stat[id];
+
+	uint8_t b = 0;
+	for (uint32_t c = cycles >> (PROF_SHIFT + 1); c && b < PROF_BUCKETS - 1; c >>= 1) {
+		b++;
+	}
+
+	if (s.count != 0xfffffffful) {
+		s.count++;
+	}
+	if (cycles > s.max) {
+		s.max = cycles;
+	}
+	if (s.hist[b] != 0xffff) {
+		s.hist[b]++;
+	}
+}
+
+void Prof::reset() {
+	memset(stat, 0, sizeof(stat));
+}
+
+void Prof::dump(Print &out) {
+	for (uint8_t i = 0; i < PROF_SECTIONS; i++) {
+		const ProfStat &s = stat[i];
+
+		for (const char *p = profNames[i]; pgm_read_byte(p); p++) {
+			out.print((char)pgm_read_byte(p));
+		}
+		out.print(' ');
+		out.print(s.count);
+		out.print(' ');
+		out.print(s.max);
+		for (uint8_t b = 0; b < PROF_BUCKETS; b++) {
+			out.print(' ');
+			out.print(s.hist[b]);
+		}
+		out.println();
+	}
+}
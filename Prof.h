@@ -0,0 +1,75 @@
+/*
+ * Prof.h
+ *
+ *  Loop latency profiling on a free running Timer1.
+ *
+ *  Timer1 counts CPU cycles (no prescaler) and its overflow interrupt
+ *  extends it to 32 bits, so a section is timed to the cycle up to about
+ *  four minutes. Each section keeps a count, its maximum and a histogram
+ *  with one bucket per power of two: bucket 0 is below 2^(PROF_SHIFT+1)
+ *  cycles, the last one is 2^(PROF_SHIFT+PROF_BUCKETS-1) and above.
+ *  Counts stop at 0xffff.
+ *
+ *  Timing a section costs about a hundred cycles and the statistics take
+ *  180 bytes of RAM. Everything compiles away unless EN_PROF is defined.
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#define PROF_BUCKETS	14
+#define PROF_SHIFT		8		// bucket 0 < 512 cycles (32us), last >= 131ms
+
+enum ProfId {
+	PROF_LOOP,		// one pass of loop()
+	PROF_SAMPLE,	// readEnv(), the DHT22 read
+	PROF_LCD,		// displayTime()
+	PROF_LOG,		// log2Sd()
+	PROF_SERIAL,	// procSerial() and procFrame()
+	PROF_SECTIONS
+};
+
+struct ProfStat {
+	uint32_t count;
+	uint32_t max;
+	uint16_t hist[PROF_BUCKETS];
+};
+
+class Prof {
+public:
+	static void begin();
+	static uint32_t now();	// cycles
+	static void add(uint8_t id, uint32_t cycles);
+	static void reset();
+
+	// one line per section: name count max hist...
+	static void dump(Print &out);
+
+	static ProfStat stat[PROF_SECTIONS];
+};
+
+class ProfScope {
+public:
+	ProfScope(uint8_t id) : _id(id), _start(Prof::now()) {
+	}
+	~ProfScope() {
+		Prof::add(_id, Prof::now() - _start);
+	}
+
+private:
+	uint8_t _id;
+	uint32_t _start;
+};
+
+#ifdef EN_PROF
+#define PROF_SCOPE(id)	ProfScope _prof(id)
+#else
+#define PROF_SCOPE(id)
+#endif
+
+#endif /* PROF_H_ */
@@ -0,0 +1,90 @@
+/*
+ * Ring.h
+ *
+ *  Single producer, single consumer queue between an interrupt handler and
+ *  the loop, or the other way round. Neither side turns interrupts off:
+ *  each index is one byte and written by one side only, and an element is
+ *  complete before the index that hands it over moves.
+ *
+ *  N is a power of two up to 128; the indices run freely and are masked,
+ *  so all N slots are usable. A push onto a full ring is counted in drops()
+ *  and otherwise lost.
+ */
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdint.h>
+
+// keep the compiler from moving element accesses across an index update
+#define RING_BARRIER()	__asm__ __volatile__ ("" ::: "memory")
+
+template<class T, uint8_t N> class Ring {
+	typedef char SizeCheck[(N & (N - 1)) == 0 && N <= 128 ? 1 : -1];
+
+public:
+	Ring() : _head(0), _tail(0), _drops(0) {
+	}
+
+	// producer side
+	bool push(const T &v) {
+		uint8_t h = _head;
+		if ((uint8_t)(h - _tail) == N) {
+			if (_drops != 0xffff) {
+				_drops++;
+			}
+			return false;
+		}
+		_buf[h & (N - 1)] = v;
+		RING_BARRIER();
+		_head = h + 1;
+		return true;
+	}
+
+	// consumer side
+	bool pop(T &v) {
+		uint8_t t = _tail;
+		if (t == _head)
+			return false;
+		RING_BARRIER();
+		v = _buf[t & (N - 1)];
+		RING_BARRIER();
+		_tail = t + 1;
+		return true;
+	}
+
+	bool peek(T &v) const {
+		uint8_t t = _tail;
+		if (t == _head)
+			return false;
+		RING_BARRIER();
+		v = _buf[t & (N - 1)];
+		return true;
+	}
+
+	// either side
+	uint8_t count() const {
+		return _head - _tail;
+	}
+
+	uint8_t space() const {
+		return N - count();
+	}
+
+	// two byte counter, read until both reads agree
+	uint16_t drops() const {
+		uint16_t d;
+		do {
+			d = _drops;
+		} while (d != _drops);
+		return d;
+	}
+
+private:
+	T _buf[N];
+	volatile uint8_t _head;		// written by the producer
+	volatile uint8_t _tail;		// written by the consumer
+	volatile uint16_t _drops;	// written by the producer
+};
+
+#endif /* RING_H_ */
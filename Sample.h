@@ -0,0 +1,29 @@
+/*
+ * Sample.h
+ *
+ *  One snapshot of every reading, kept in fixed point so that it can be
+ *  compared, logged and sent without going through float formatting.
+ *  It is also the wire format of FT_SAMPLE, little endian and packed.
+ */
+
+#ifndef SAMPLE_H_
+#define SAMPLE_H_
+
+#include <stdint.h>
+
+#define SMP_F_DHT_ERR	0x01	// temperature/humidity could not be read
+#define SMP_F_PM_INIT	0x02	// DSM501 has no complete window yet
+#define SMP_F_WARMING	0x04	// DSM501 still warming up after power on
+
+struct __attribute__((packed)) Sample {
+	uint32_t time;			// seconds since 2000-01-01, see DS1307::getEpoch()
+	uint16_t seq;			// bumped each time a new snapshot is taken
+	int16_t  temperature;	// 0.01 C
+	uint16_t humidity;		// 0.01 %RH
+	uint32_t pm10;			// 0.01 ug/m3
+	uint32_t pm25;			// 0.01 ug/m3
+	int16_t  aqi;			// -1 while initializing
+	uint8_t  flags;			// SMP_F_*
+};
+
+#endif /* SAMPLE_H_ */
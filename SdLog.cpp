@@ -0,0 +1,176 @@
+/*
+ * SdLog.cpp
+ *
+ *  See SdLog.h.
+ */
+
+#include "SdLog.h"
+#include "SD.h"
+
+#define SDL_NONE	0xfffffffful
+
+/*
+ * FILE_WRITE of the SD library sets O_APPEND as well, which moves every
+ * write to the end of the file whatever seek() said.
+ */
+#define SDL_OPEN	(O_READ | O_WRITE | O_CREAT)
+
+SdLog::SdLog(uint8_t csPin, const char *name, Writer writer)
+		: _cs(csPin), _name(name), _writer(writer) {
+	_present = false;
+	_gone = false;
+	_lastProbe = 0;
+	_backoff = 0;
+	_resume = SDL_NONE;
+}
+
+void SdLog::begin() {
+	pinMode(_cs, OUTPUT);
+#ifdef SDL_CD_PIN
+	pinMode(SDL_CD_PIN, INPUT_PULLUP);
+#endif
+	probe(millis());
+}
+
+#ifdef SDL_KNOCK
+static uint8_t spiXfer(uint8_t b) {
+	SPDR = b;
+	while (!(SPSR & _BV(SPIF)))
+		;
+	return SPDR;
+}
+#endif
+
+/*
+ * Whether a card answers a single CMD0 (go idle). SD.begin() sets the
+ * SPI bus up again afterwards.
+ */
+bool SdLog::knock() {
+#ifdef SDL_KNOCK
+	pinMode(SS, OUTPUT);	// or the SPI drops out of master mode
+	pinMode(MOSI, OUTPUT);
+	pinMode(SCK, OUTPUT);
+	digitalWrite(_cs, HIGH);
+	SPCR = _BV(SPE) | _BV(MSTR) | _BV(SPR1) | _BV(SPR0);	// clk/128
+	SPSR &= ~_BV(SPI2X);
+
+	// 80 clocks with CS high to wake the card up
+	for (uint8_t i = 0; i < 10; i++) {
+		spiXfer(0xff);
+	}
+
+	static const uint8_t cmd0[6] PROGMEM = { 0x40, 0, 0, 0, 0, 0x95 };
+	digitalWrite(_cs, LOW);
+	for (uint8_t i = 0; i < sizeof(cmd0); i++) {
+		spiXfer(pgm_read_byte(&cmd0[i]));
+	}
+	uint8_t r = 0xff;
+	for (uint8_t i = 0; i < 8 && r == 0xff; i++) {
+		r = spiXfer(0xff);
+	}
+	digitalWrite(_cs, HIGH);
+	spiXfer(0xff);
+
+	return r == 0x01;
+#else
+	return true;
+#endif
+}
+
+void SdLog::backOff() {
+	_backoff = _backoff ? _backoff * 2 : SDL_PROBE_MIN;
+	if (_backoff > SDL_PROBE_MAX) {
+		_backoff = SDL_PROBE_MAX;
+	}
+}
+
+void SdLog::probe(uint32_t now) {
+	_lastProbe = now;
+
+#ifdef SDL_CD_PIN
+	// the switch closes to ground with a card in
+	if (digitalRead(SDL_CD_PIN) != LOW) {
+		_backoff = SDL_PROBE_MIN;
+		return;
+	}
+#endif
+
+	if (!knock()) {
+		backOff();
+		return;
+	}
+
+	if (SD.begin(_cs)) {
+		_present = true;
+		flush();
+		return;
+	}
+
+#ifndef SDL_NO_END
+	SD.end();
+#endif
+	backOff();
+}
+
+/*
+ * The card went away under a write, look for it again soon.
+ */
+void SdLog::lost(uint32_t now) {
+#ifdef SDL_NO_END
+	_gone = true;
+#else
+	SD.end();
+#endif
+	_present = false;
+	_lastProbe = now;
+	_backoff = SDL_PROBE_MIN;
+}
+
+bool SdLog::add(const Sample &s) {
+	bool ok = _queue.push(s);
+	flush();
+	return ok;
+}
+
+/*
+ * A record leaves the queue only once it is on the card.
+ */
+bool SdLog::flush() {
+	if (!_present)
+		return false;
+	if (!_queue.count())
+		return true;
+
+	File f = SD.open(_name, SDL_OPEN);
+	if (!f) {
+		lost(millis());
+		return false;
+	}
+
+	Sample s;
+	while (_queue.peek(s)) {
+		// over our own torn line, unless the file moved on: another card
+		uint32_t at = f.size();
+		if (_resume != SDL_NONE && at > _resume && at - _resume < SDL_REC_MAX) {
+			at = _resume;
+		}
+		_resume = SDL_NONE;
+		if (!f.seek(at)) {
+			f.close();
+			lost(millis());
+			return false;
+		}
+
+		_writer(f, s);
+		if (f.getWriteError()) {
+			_resume = at;
+			f.close();
+			lost(millis());
+			return false;
+		}
+		_queue.pop(s);
+	}
+
+	f.close();
+	return true;
+}
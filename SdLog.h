@@ -0,0 +1,94 @@
+/*
+ * SdLog.h
+ *
+ *  The SD card log, kept going across card swaps.
+ *
+ *  Records are queued as Samples and written out whenever the card is
+ *  there; while it is not, up to SDL_BACKLOG of them wait in RAM and any
+ *  more are counted as dropped. A record that fails halfway is written
+ *  again from where it started, over what made it to the card, so the
+ *  log gets neither a torn line nor a repeat. A card that fails a write is
+ *  taken as gone and probed again after SDL_PROBE_MIN, doubling up to
+ *  SDL_PROBE_MAX while it stays away.
+ *
+ *  SD.begin() waits the better part of a second on a missing card, so a
+ *  probe first knocks: one CMD0 at 125kHz, about a millisecond, and only
+ *  a card that answers gets the full SD.begin(). With a socket switch on
+ *  SDL_CD_PIN even that is left out.
+ */
+
+#ifndef SDLOG_H_
+#define SDLOG_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "Sample.h"
+#include "Ring.h"
+
+#ifndef SDL_BACKLOG
+#define SDL_BACKLOG		8		// records, power of two
+#endif
+#define SDL_REC_MAX		128		// longest record, bytes
+#define SDL_PROBE_MIN	1000ul
+#define SDL_PROBE_MAX	64000ul
+
+// the stand-ins for the SD library have no card on the SPI bus to knock on
+#if defined(__AVR__) && !defined(SDL_NO_KNOCK)
+#define SDL_KNOCK
+#endif
+
+/*
+ * Starting over with a card takes SD.end(), which the SD library has since
+ * 1.2 (Arduino 1.6). The one in Arduino 1.0.x can only begin() once: build
+ * with SDL_NO_END there, and a card that went away stays away until reset.
+ */
+
+class SdLog {
+public:
+	// writes one record, a line of text
+	typedef void (*Writer)(Print &out, const Sample &s);
+
+	SdLog(uint8_t csPin, const char *name, Writer writer);
+	void begin();
+
+	// queue a record and write out what is queued, false when it was dropped
+	bool add(const Sample &s);
+	bool flush();
+
+	// whether probe() should run now
+	bool probeDue(uint32_t now) const {
+		return !_present && !_gone && now - _lastProbe >= _backoff;
+	}
+	void probe(uint32_t now);
+
+	bool present() const {
+		return _present;
+	}
+	uint8_t backlog() const {
+		return _queue.count();
+	}
+	uint16_t drops() const {
+		return _queue.drops();
+	}
+
+protected:
+	void lost(uint32_t now);
+	bool knock();
+	void backOff();
+
+private:
+	uint8_t  _cs;
+	const char *_name;
+	Writer   _writer;
+	uint8_t  _present;
+	uint8_t  _gone;		// lost and no SD.end() to start over, see SDL_NO_END
+	uint32_t _lastProbe;
+	uint32_t _backoff;
+	uint32_t _resume;	// file offset of a record cut short, or SDL_NONE
+	Ring<Sample, SDL_BACKLOG> _queue;
+};
+
+#endif /* SDLOG_H_ */
@@ -0,0 +1,143 @@
+/*
+ * SerCmd.cpp
+ *
+ *  Incremental parser for the single letter serial commands.
+ */
+
+#include "SerCmd.h"
+
+SerCmd::SerCmd(Stream &port, const SerCmdSpec *specs, Handler handler,
+		FrameHandler frameHandler) :
+	_port(port), _specs(specs), _handler(handler), _frameHandler(frameHandler) {
+	reset();
+}
+
+void SerCmd::reset() {
+	_state = SC_Cmd;
+	_cmd = 0;
+	_spec = SC_ARG_NONE;
+	_len = 0;
+	_last = 0;
+}
+
+uint8_t SerCmd::argSpec(uint8_t cmd) const {
+	for (const SerCmdSpec *p = _specs; p->cmd; p++) {
+		if (p->cmd == cmd)
+			return p->arg;
+	}
+	return SC_ARG_NONE;
+}
+
+void SerCmd::poll() {
+	if (_state != SC_Cmd && millis() - _last > SC_TIMEOUT) {
+		// the host gave up half way, do not let the rest of it linger
+		_port.print((char)SC_ERROR);
+		reset();
+	}
+
+	while (_port.available()) {
+		_last = millis();
+		feed(_port.read());
+	}
+}
+
+void SerCmd::feed(uint8_t c) {
+	switch (_state) {
+	case SC_Cmd:
+		if (c == FRM_DELIM && _frameHandler) {
+			_len = 0;
+			_state = SC_Frame;
+			break;
+		}
+		_cmd = c;
+		_spec = argSpec(c);
+		_len = 0;
+		if (_spec == SC_ARG_NONE) {
+			dispatch();
+		} else {
+			_state = SC_Sync1;
+		}
+		break;
+
+	case SC_Sync1:
+		if (c != SC_EOP) {
+			_port.print((char)SC_ERROR);
+			reset();
+			break;
+		}
+		_port.print((char)SC_OK);
+		_state = SC_Arg;
+		break;
+
+	case SC_Arg:
+		if (_spec == SC_ARG_TOKEN && c == SC_EOP) {
+			if (!_len) {
+				// no token at all, handlers would read it as 0
+				_port.print((char)SC_ERROR);
+				reset();
+				break;
+			}
+			// the terminator doubles as the closing sync
+			_port.print((char)SC_OK);
+			dispatch();
+			break;
+		}
+		if (_len >= SC_ARG_MAX) {
+			_port.print((char)SC_ERROR);
+			reset();
+			break;
+		}
+		_buf[_len++] = c;
+		if (_spec != SC_ARG_TOKEN && _len == _spec) {
+			_state = SC_Sync2;
+		}
+		break;
+
+	case SC_Sync2:
+		if (c != SC_EOP) {
+			_port.print((char)SC_ERROR);
+			reset();
+			break;
+		}
+		_port.print((char)SC_OK);
+		dispatch();
+		break;
+
+	case SC_Frame:
+		feedFrame(c);
+		break;
+	}
+}
+
+#define SC_FRM_SKIP	0xff	// _len while dropping an oversized frame
+
+void SerCmd::feedFrame(uint8_t c) {
+	if (c != FRM_DELIM) {
+		if (_len == SC_FRM_SKIP)
+			return;
+		if (_len >= FRM_ENC_MAX) {
+			_len = SC_FRM_SKIP;
+			return;
+		}
+		_buf[_len++] = c;
+		return;
+	}
+
+	if (_len == 0) // back to back delimiters, the frame starts now
+		return;
+
+	int n = (_len == SC_FRM_SKIP) ? -1 : frameOpen(_buf, _len);
+	if (n < 0) {
+		uint8_t err = FE_CRC;
+		frameSend(_port, FT_ERROR | FT_RESP, 0, &err, 1);
+	} else {
+		_frameHandler(_buf[0], _buf[1], _buf + 2, n);
+	}
+	reset();
+}
+
+void SerCmd::dispatch() {
+	_buf[_len] = 0;
+	_handler(_cmd, _buf, _len);
+	reset();
+}
@@ -0,0 +1,79 @@
+/*
+ * SerCmd.h
+ *
+ *  Incremental parser for the single letter serial commands. It consumes
+ *  whatever is available on each call and never waits for the host.
+ *  A FRM_DELIM byte in place of a command switches to a binary frame, see
+ *  Frame.h.
+ */
+
+#ifndef SERCMD_H_
+#define SERCMD_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "Frame.h"
+
+#define SC_OK		'O'
+#define SC_ERROR	'E'
+#define SC_EOP		' '
+
+#define SC_ARG_NONE		0		// command takes no argument
+#define SC_ARG_TOKEN	0xff	// argument runs up to the next SC_EOP, not empty
+#define SC_ARG_MAX		16		// longest argument, fixed or token
+
+#define SC_TIMEOUT		1000ul	// drop a partial command after 1s of silence
+
+/*
+ * A command with an argument is sent as
+ * 	<cmd> SC_EOP <arg> SC_EOP
+ * and each SC_EOP is answered with SC_OK, or SC_ERROR when it is missing.
+ * The handler runs once the second SC_EOP is in.
+ */
+struct SerCmdSpec {
+	uint8_t cmd;
+	uint8_t arg;	// SC_ARG_NONE, SC_ARG_TOKEN or a fixed length
+};
+
+class SerCmd {
+public:
+	typedef void (*Handler)(uint8_t cmd, uint8_t *arg, uint8_t len);
+	typedef void (*FrameHandler)(uint8_t type, uint8_t tag, uint8_t *data, uint8_t len);
+
+	SerCmd(Stream &port, const SerCmdSpec *specs, Handler handler,
+			FrameHandler frameHandler = 0);
+	void poll();	// called in the loop function
+	void reset();
+
+protected:
+	void feed(uint8_t c);
+	void dispatch();
+	void feedFrame(uint8_t c);
+	uint8_t argSpec(uint8_t cmd) const;
+
+private:
+	enum {
+		SC_Cmd,
+		SC_Sync1,
+		SC_Arg,
+		SC_Sync2,
+		SC_Frame,
+	};
+
+	Stream	&_port;
+	const SerCmdSpec *_specs;
+	Handler	_handler;
+	FrameHandler _frameHandler;
+
+	uint8_t	_state;
+	uint8_t	_cmd;
+	uint8_t	_spec;
+	uint8_t	_len;
+	uint8_t	_buf[FRM_ENC_MAX];	// command argument or encoded frame
+	uint32_t _last;
+};
+
+#endif /* SERCMD_H_ */
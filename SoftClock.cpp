@@ -0,0 +1,198 @@
+/*
+ * SoftClock.cpp
+ *
+ *  Millisecond clock on top of the DS1307, see SoftClock.h.
+ */
+
+#include "SoftClock.h"
+
+#define SC_MAGIC	'S'
+
+SoftClock::SoftClock(DS1307 &rtc) : _rtc(rtc) {
+	_rtcSec = _rtcEdge = _nextRead = 0;
+	_offset = _slew = 0;
+	_lastSlew = 0;
+	_refSec = 0;
+	_drift = 0;
+	_driftRem = 0;
+	_lastSync = 0;
+	_driftErr = 0;
+}
+
+void SoftClock::begin() {
+	uint8_t buf[5];
+
+	_rtc.readRam(SC_NVRAM_ADDR, buf, sizeof(buf));
+	if (buf[0] == SC_MAGIC) {
+		memcpy(&_drift, buf + 1, sizeof(_drift));
+		if (_drift > SC_DRIFT_MAX || _drift < -SC_DRIFT_MAX) {
+			_drift = 0;
+		}
+	}
+
+	_rtcSec = _refSec = _rtc.getEpoch();
+	_rtcEdge = _lastSlew = _nextRead = millis();
+}
+
+void SoftClock::readRtc(uint32_t now) {
+	uint32_t t = _rtc.getEpoch();
+	if (t != _rtcSec) {
+		// the edge was somewhere within the last retry
+		_rtcSec = t;
+		_rtcEdge = now;
+		_nextRead = now + 995ul;
+	} else {
+		_nextRead = now + 5ul;
+	}
+}
+
+/*
+ * Drift in ms since _refSec at sec, and in rem what is left of it below a
+ * millisecond, in ppb*s. The product needs 64 bits: 50 ppm overflows 32
+ * after about 12 hours.
+ */
+int32_t SoftClock::driftMs(uint32_t sec, int32_t &rem) const {
+	int64_t d = (int64_t)(int32_t)(sec - _refSec) * _drift + _driftRem;
+	int32_t ms = d / 1000000l;
+	rem = d - (int64_t)ms * 1000000l;
+	return ms;
+}
+
+/*
+ * Move the drift so far into _offset, keeping the fraction of a
+ * millisecond for the next time; folds can be seconds apart.
+ */
+void SoftClock::foldDrift() {
+	int32_t rem;
+	_offset += driftMs(_rtcSec, rem);
+	_driftRem = rem;
+	_refSec = _rtcSec;
+}
+
+/*
+ * Hand whole seconds of offset back to the RTC. Writing the seconds
+ * register restarts its divider, so do it right at a corrected edge.
+ */
+void SoftClock::foldSeconds(uint32_t now) {
+	TimeStamp ts;
+	foldDrift();
+	this->now(ts);
+	if (ts.ms > 20)
+		return;
+
+	_rtc.setEpoch(ts.sec);
+	_rtcSec = _refSec = ts.sec;
+	_rtcEdge = now - ts.ms;
+	_nextRead = now + 995ul;
+	_offset = 0;
+}
+
+void SoftClock::poll() {
+	uint32_t m = millis();
+
+	if ((int32_t)(m - _nextRead) >= 0) {
+		readRtc(m);
+	}
+
+	uint32_t steps = (m - _lastSlew) / SC_SLEW_DIV;
+	if (steps) {
+		_lastSlew += steps * SC_SLEW_DIV;
+		if (_slew > 0) {
+			int32_t n = (int32_t)steps < _slew ? (int32_t)steps : _slew;
+			_offset += n;
+			_slew -= n;
+		} else if (_slew < 0) {
+			int32_t n = (int32_t)steps < -_slew ? (int32_t)steps : -_slew;
+			_offset -= n;
+			_slew += n;
+		}
+	}
+
+	if (_rtcSec - _refSec >= SC_FOLD_SPAN) {
+		foldDrift();
+	}
+
+	if (_offset >= 1000l || _offset <= -1000l) {
+		foldSeconds(m);
+	}
+}
+
+void SoftClock::now(TimeStamp &ts) {
+	uint32_t e = millis() - _rtcEdge;
+	uint32_t sec = _rtcSec + e / 1000ul;
+	int32_t ms = e % 1000ul;
+
+	int32_t rem;
+	ms += _offset + driftMs(sec, rem);
+	while (ms < 0) {
+		ms += 1000;
+		sec--;
+	}
+	sec += ms / 1000;
+	ts.sec = sec;
+	ts.ms = ms % 1000;
+}
+
+uint32_t SoftClock::now() {
+	TimeStamp ts;
+	now(ts);
+	return ts.sec;
+}
+
+void SoftClock::set(uint32_t sec) {
+	_rtc.setEpoch(sec);
+	_rtcSec = _refSec = sec;
+	_rtcEdge = _nextRead = millis();
+	_offset = _slew = 0;
+	_driftRem = 0;
+	_lastSync = 0;	// no base to learn drift from
+}
+
+void SoftClock::adjust(int32_t ms, uint16_t rtt) {
+	uint32_t sec = now();
+
+	foldDrift();
+
+	if (ms > SC_STEP_MS || ms < -SC_STEP_MS) {
+		// ms includes what is still pending, as below
+		_offset += ms;
+		_slew = 0;
+		_lastSync = 0;
+		return;
+	}
+
+	// what the last sync left pending is part of ms already
+	int32_t err = ms - _slew;
+	_slew = ms;
+
+	if (!_lastSync) {
+		_lastSync = sec;
+		_driftErr = 0;
+		return;
+	}
+
+	_driftErr += err;
+	if (sec - _lastSync < SC_DRIFT_SPAN || rtt > SC_DRIFT_RTT)
+		return;
+
+	if (_driftErr > SC_STEP_MS || _driftErr < -SC_STEP_MS) {
+		// not drift, start over
+		_lastSync = sec;
+		_driftErr = 0;
+		return;
+	}
+
+	_drift += _driftErr * 1000000l / (int32_t)(sec - _lastSync) / 2;
+	if (_drift > SC_DRIFT_MAX) {
+		_drift = SC_DRIFT_MAX;
+	} else if (_drift < -SC_DRIFT_MAX) {
+		_drift = -SC_DRIFT_MAX;
+	}
+	_lastSync = sec;
+	_driftErr = 0;
+
+	uint8_t buf[5];
+	buf[0] = SC_MAGIC;
+	memcpy(buf + 1, &_drift, sizeof(_drift));
+	_rtc.writeRam(SC_NVRAM_ADDR, buf, sizeof(buf));
+}
@@ -0,0 +1,102 @@
+/*
+ * SoftClock.h
+ *
+ *  Millisecond clock on top of the DS1307, disciplined by the host.
+ *
+ *  The RTC gives whole seconds; the second edges are tracked with millis()
+ *  to interpolate within a second. On top of that come an offset and a
+ *  drift rate, both learnt from FT_TIME_SYNC / FT_TIME_ADJ exchanges:
+ *
+ *  	host: t1 -> device: t2, t3 -> host: t4
+ *  	delay  = (t4 - t1) - (t3 - t2)
+ *  	offset = ((t2 - t1) + (t3 - t4)) / 2
+ *
+ *  The host then sends -offset and the delay with FT_TIME_ADJ. Small
+ *  corrections are slewed in at SC_SLEW_DIV, large ones are stepped. What
+ *  is left over after SC_DRIFT_SPAN goes into the drift rate, which is kept
+ *  in the DS1307 RAM so it survives power cycles. Whole seconds of offset
+ *  are written back to the RTC so the LCD time stays right as well.
+ */
+
+#ifndef SOFTCLOCK_H_
+#define SOFTCLOCK_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#include "DS1307.h"
+
+#define SC_STEP_MS		2000l		// step instead of slew above this
+#define SC_SLEW_DIV		20			// slew 1ms every 20ms, 5%
+#define SC_DRIFT_SPAN	900ul		// s between syncs before drift is learnt
+#define SC_DRIFT_RTT	250u		// ms, slower exchanges do not teach drift
+#define SC_DRIFT_MAX	500000l		// ppb
+#define SC_FOLD_SPAN	3600ul		// s, drift is folded into the offset
+#define SC_NVRAM_ADDR	0			// DS1307 RAM, magic + drift
+
+struct __attribute__((packed)) TimeStamp {
+	uint32_t sec;	// seconds since 2000-01-01
+	uint16_t ms;
+};
+
+struct __attribute__((packed)) TimeSync {
+	TimeStamp t1;	// host, as received
+	TimeStamp t2;	// device, on receipt
+	TimeStamp t3;	// device, on reply
+};
+
+struct __attribute__((packed)) TimeAdj {
+	int32_t  adj;	// ms to add to the device clock
+	uint16_t rtt;	// ms, the measured delay
+};
+
+struct __attribute__((packed)) TimeAdjResp {
+	int32_t drift;	// ppb, positive when the RTC runs slow
+	int32_t offset;	// ms currently added to the RTC
+};
+
+class SoftClock {
+public:
+	SoftClock(DS1307 &rtc);
+	void begin();
+	void poll();	// called in the loop function
+
+	uint32_t now();
+	void now(TimeStamp &ts);
+
+	void set(uint32_t sec);
+	void adjust(int32_t ms, uint16_t rtt);
+
+	int32_t getDrift() const {
+		return _drift;
+	}
+	int32_t getOffset() const {
+		return _offset + _slew;
+	}
+
+protected:
+	void readRtc(uint32_t now);
+	int32_t driftMs(uint32_t sec, int32_t &rem) const;
+	void foldDrift();
+	void foldSeconds(uint32_t now);
+
+private:
+	DS1307	&_rtc;
+
+	uint32_t _rtcSec;	// last second read from the RTC
+	uint32_t _rtcEdge;	// millis() when it started
+	uint32_t _nextRead;
+
+	int32_t	_offset;	// ms added to the RTC
+	int32_t	_slew;		// ms still to go into _offset
+	uint32_t _lastSlew;
+	uint32_t _refSec;	// RTC second the drift is counted from
+	int32_t	_drift;		// ppb
+	int32_t	_driftRem;	// ppb*s of drift not yet in _offset
+	uint32_t _lastSync;	// start of the drift measurement, 0 = none
+	int32_t	_driftErr;	// ms corrected since _lastSync
+};
+
+#endif /* SOFTCLOCK_H_ */
@@ -16,8 +16,16 @@ extern "C" {
 #include <avr/pgmspace.h>   /* required by usbdrv.h */
 #include "usbdrv/usbdrv.h"
 
+/* driver state, not exported by usbdrv.h in this configuration */
+extern volatile uchar usbTxLen;
+extern volatile schar usbRxLen;
+
 }
 
+#include <string.h>
+#include "SD.h"
+#include "EEStore.h"
+#include "Config.h"
 #include "USBPort.h"
 USBPort UsbPort;
 
@@ -25,26 +33,155 @@ USBPort UsbPort;
 /* ----------------------------- USB interface ----------------------------- */
 /* ------------------------------------------------------------------------- */
 
-PROGMEM const char usbHidReportDescriptor[22] = {    /* USB report descriptor */
+PROGMEM const char usbHidReportDescriptor[41] = {    /* USB report descriptor */
     0x06, 0x00, 0xff,              // USAGE_PAGE (Generic Desktop)
     0x09, 0x01,                    // USAGE (Vendor Usage 1)
     0xa1, 0x01,                    // COLLECTION (Application)
     0x15, 0x00,                    //   LOGICAL_MINIMUM (0)
     0x26, 0xff, 0x00,              //   LOGICAL_MAXIMUM (255)
     0x75, 0x08,                    //   REPORT_SIZE (8)
+    0x85, USB_RID_EEPROM,          //   REPORT_ID (1)
     0x95, 0x80,                    //   REPORT_COUNT (128)
     0x09, 0x00,                    //   USAGE (Undefined)
     0xb2, 0x02, 0x01,              //   FEATURE (Data,Var,Abs,Buf)
+    0x85, USB_RID_SAMPLE,          //   REPORT_ID (2)
+    0x95, sizeof(Sample),          //   REPORT_COUNT (sizeof(Sample))
+    0x09, 0x00,                    //   USAGE (Undefined)
+    0xb2, 0x02, 0x01,              //   FEATURE (Data,Var,Abs,Buf)
+    0x85, USB_RID_STREAM,          //   REPORT_ID (3)
+    0x95, sizeof(Sample),          //   REPORT_COUNT (sizeof(Sample))
+    0x09, 0x00,                    //   USAGE (Undefined)
+    0x81, 0x02,                    //   INPUT (Data,Var,Abs)
     0xc0                           // END_COLLECTION
 };
-/* Since we define only one feature report, we don't use report-IDs (which
- * would be the first byte of the report). The entire report consists of 128
- * opaque data bytes.
+/* Every report starts with its report-ID. USB_RID_EEPROM is 128 opaque
+ * bytes kept in EEPROM, USB_RID_SAMPLE and USB_RID_STREAM are the Sample
+ * struct, little endian.
  */
 
 /* The following variables store the status of the current data transfer */
 static uchar    currentAddress;
 static uchar    bytesRemaining;
+static uchar    reportId;       /* still to be sent/skipped before the data */
+static uchar    readLog;        /* usbFunctionRead() serves the SD log */
+
+/* SET_REPORT data is collected here and handed to the EEPROM in the
+ * background, the callback never waits for a write to finish. While that
+ * is going on the staged copy is the current one; another SET_REPORT in
+ * that time is stalled and has to be retried by the host.
+ */
+static EEBlock  usbBlock(USB_EE_BASE, USB_EE_SIZE, USB_EE_SLOTS);
+static uchar    eeStage[USB_EE_SIZE];
+
+/* USB_VREQ_CFG_GET/SET, the value travels through here */
+static uchar    cfgId = 0xff;   /* field being set, 0xff = none */
+static uint32_t cfgValue;
+
+/* The latest sample, and the copy a GET_REPORT is being served from. The
+ * copy is taken in usbFunctionSetup() so that a new sample arriving in the
+ * middle of a transfer can not tear the report.
+ */
+static Sample   liveSample;
+static uchar    sampleReport[1 + sizeof(Sample)];
+
+/* Interrupt-in reports are double buffered: setSample() only ever writes
+ * the back buffer, poll() swaps it in once the front one is out, and feeds
+ * the front one to the endpoint 8 bytes at a time. A sample that comes in
+ * while the back buffer is still waiting replaces it.
+ */
+static uchar    streamBuf[2][1 + sizeof(Sample)];
+static uchar    streamFront;    /* index of the buffer being sent */
+static uchar    streamPending;  /* back buffer holds a new report */
+static uchar    streamSent;     /* bytes of the front buffer sent, 0 = idle */
+
+/* quiet() bookkeeping */
+static volatile uchar usbRxSeen;    /* set by the driver for every packet */
+static uint32_t usbLastRx;
+static uchar    deferring;
+static uint32_t deferSince;
+
+void usbRxUserHook(void)
+{
+    usbRxSeen = 1;
+}
+
+/* USB_VREQ_LOG_READ keeps the log open and reads ahead of the host: the
+ * buffer is topped up in USBPort::poll() between packets, so most packets
+ * are a plain copy. The SD library caches the current sector underneath.
+ */
+static const char *logName;
+static File     logFile;
+static uint32_t logSize;
+static unsigned logRemaining;   /* still to be read from the file */
+static uchar    logBuf[USB_LOG_AHEAD];
+static uchar    logHead;
+static uchar    logCount;
+
+static void logReadAhead()
+{
+    while (logRemaining && logCount < sizeof(logBuf)) {
+        uchar tail = (logHead + logCount) % sizeof(logBuf);
+        unsigned n = (tail < logHead ? logHead : sizeof(logBuf)) - tail;
+        if (n > logRemaining)
+            n = logRemaining;
+        int got = logFile.read(logBuf + tail, n);
+        if (got <= 0) {
+            logRemaining = 0;
+            break;
+        }
+        logCount += got;
+        logRemaining -= got;
+    }
+}
+
+static uchar logRead(uchar *data, uchar len)
+{
+    if (logCount < len)
+        logReadAhead();
+    if (len > logCount)
+        len = logCount;
+    for (uchar i = 0; i < len; i++) {
+        data[i] = logBuf[logHead];
+        logHead = (logHead + 1) % sizeof(logBuf);
+    }
+    logCount -= len;
+    if (!logRemaining && !logCount)
+        logFile.close();    /* all sent, let the logger have the card */
+    return len;
+}
+
+static uchar logOpen()
+{
+    if (logFile)
+        logFile.close();
+    logHead = logCount = 0;
+    logRemaining = 0;
+    logSize = 0;
+
+    logFile = SD.open(logName, FILE_READ);
+    if (!logFile)
+        return 0;
+    logSize = logFile.size();
+    return 1;
+}
+
+static usbMsgLen_t logSetup(usbRequest_t *rq)
+{
+    if (!logOpen())
+        return 0;
+
+    uint32_t offset = rq->wValue.word | ((uint32_t)rq->wIndex.word << 16);
+    if (offset >= logSize || !logFile.seek(offset)) {
+        logFile.close();
+        return 0;
+    }
+    logRemaining = rq->wLength.word;
+    if (logRemaining > logSize - offset)
+        logRemaining = logSize - offset;
+    logReadAhead();
+    readLog = 1;
+    return USB_NO_MSG; /* use usbFunctionRead() to obtain data */
+}
 
 /* ------------------------------------------------------------------------- */
 
@@ -53,11 +190,22 @@ static uchar    bytesRemaining;
  */
 uchar usbFunctionRead(uchar *data, uchar len)
 {
-    if(len > bytesRemaining)
-        len = bytesRemaining;
-    eeprom_read_block(data, (uchar *)0 + currentAddress, len);
-    currentAddress += len;
-    bytesRemaining -= len;
+    if(readLog)
+        return logRead(data, len);
+
+    uchar n = 0;
+    if(reportId && len) {
+        data[n++] = reportId;
+        reportId = 0;
+    }
+    if(len - n > bytesRemaining)
+        len = bytesRemaining + n;
+    if (usbBlock.busy())
+        memcpy(data + n, eeStage + currentAddress, len - n);
+    else
+        usbBlock.read(currentAddress, data + n, len - n);
+    currentAddress += len - n;
+    bytesRemaining -= len - n;
     return len;
 }
 
@@ -66,14 +214,36 @@ uchar usbFunctionRead(uchar *data, uchar len)
  */
 uchar usbFunctionWrite(uchar *data, uchar len)
 {
+    if(cfgId != 0xff) {
+        if(len > sizeof(cfgValue) - currentAddress)
+            len = sizeof(cfgValue) - currentAddress;
+        memcpy((uchar *)&cfgValue + currentAddress, data, len);
+        currentAddress += len;
+        if(currentAddress < sizeof(cfgValue))
+            return 0;
+        uchar id = cfgId;
+        cfgId = 0xff;
+        /* applied from the main loop; a bad id or value stalls */
+        return config.set(id, cfgValue) ? 1 : 0xff;
+    }
     if(bytesRemaining == 0)
         return 1;               /* end of transfer */
+    if(usbBlock.busy())
+        return 0xff;            /* previous report still being written */
+    if(reportId && len) {       /* skip the report-ID */
+        data++;
+        len--;
+        reportId = 0;
+    }
     if(len > bytesRemaining)
         len = bytesRemaining;
-    eeprom_write_block(data, (uchar *)0 + currentAddress, len);
+    memcpy(eeStage + currentAddress, data, len);
     currentAddress += len;
     bytesRemaining -= len;
-    return bytesRemaining == 0; /* return 1 if this was the last chunk */
+    if(bytesRemaining)
+        return 0;
+    usbBlock.commit(eeStage);
+    return 1;                   /* this was the last chunk */
 }
 
 /* ------------------------------------------------------------------------- */
@@ -82,20 +252,53 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
  {
 	usbRequest_t *rq = (usbRequest_t *)data;
 
+	if (readLog)
+		logFile.close(); /* the host gave up on the last LOG_READ */
+	readLog = 0;
+	cfgId = 0xff;
+
 	if ((rq->bmRequestType & USBRQ_TYPE_MASK) == USBRQ_TYPE_CLASS) { /* HID class request */
 		if (rq->bRequest == USBRQ_HID_GET_REPORT) { /* wValue: ReportType (highbyte), ReportID (lowbyte) */
-			/* since we have only one report type, we can ignore the report-ID */
-			bytesRemaining = 128;
+			if (rq->wValue.bytes[0] == USB_RID_SAMPLE) {
+				/* straight from RAM, no usbFunctionRead() involved */
+				sampleReport[0] = USB_RID_SAMPLE;
+				memcpy(sampleReport + 1, &liveSample, sizeof(Sample));
+				usbMsgPtr = (usbMsgPtr_t)sampleReport;
+				return sizeof(sampleReport);
+			}
+			reportId = USB_RID_EEPROM;
+			bytesRemaining = USB_EE_SIZE;
 			currentAddress = 0;
 			return USB_NO_MSG; /* use usbFunctionRead() to obtain data */
 		} else if (rq->bRequest == USBRQ_HID_SET_REPORT) {
-			/* since we have only one report type, we can ignore the report-ID */
-			bytesRemaining = 128;
+			if (rq->wValue.bytes[0] != USB_RID_EEPROM)
+				return 0; /* the sample report is read only */
+			reportId = USB_RID_EEPROM;
+			bytesRemaining = USB_EE_SIZE;
 			currentAddress = 0;
 			return USB_NO_MSG; /* use usbFunctionWrite() to receive data from host */
 		}
-	} else {
-		/* ignore vendor type requests, we don't use any */
+	} else if ((rq->bmRequestType & USBRQ_TYPE_MASK) == USBRQ_TYPE_VENDOR) {
+		if (rq->bRequest == USB_VREQ_LOG_SIZE) {
+			if (logOpen())
+				logFile.close();
+			usbMsgPtr = (usbMsgPtr_t)&logSize;
+			return 4;
+		} else if (rq->bRequest == USB_VREQ_LOG_READ) {
+			return logSetup(rq);
+		} else if (rq->bRequest == USB_VREQ_CFG_GET) {
+			if (!config.get(rq->wIndex.bytes[0], cfgValue))
+				return 0;
+			usbMsgPtr = (usbMsgPtr_t)&cfgValue;
+			return sizeof(cfgValue);
+		} else if (rq->bRequest == USB_VREQ_CFG_SET) {
+			if (rq->wIndex.bytes[0] >= CFG_FIELDS)
+				return 0;
+			cfgId = rq->wIndex.bytes[0];
+			cfgValue = 0;
+			currentAddress = 0;
+			return USB_NO_MSG; /* use usbFunctionWrite() to receive the value */
+		}
 	}
 	return 0;
 }
@@ -103,7 +306,10 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
 /* ------------------------------------------------------------------------- */
 
 
-void USBPort::begin() {
+void USBPort::begin(const char *logFile) {
+	logName = logFile;
+	usbBlock.begin();
+
 	wdt_enable(WDTO_1S);
 	usbInit();
 
@@ -121,6 +327,66 @@ void USBPort::begin() {
 void USBPort::poll() {
     wdt_reset();
     usbPoll();
+
+    if (usbRxSeen) {
+        usbRxSeen = 0;
+        usbLastRx = millis();
+    }
+
+    if (readLog)
+        logReadAhead();
+
+    if (!usbInterruptIsReady())
+        return;
+
+    if (streamSent == 0) {
+        if (!streamPending)
+            return;
+        streamFront ^= 1;
+        streamPending = 0;
+    }
+
+    uchar n = sizeof(streamBuf[0]) - streamSent;
+    if (n > 8)
+        n = 8;
+    usbSetInterrupt(streamBuf[streamFront] + streamSent, n);
+    streamSent += n;
+    if (streamSent == sizeof(streamBuf[0]))
+        streamSent = 0;
+}
+
+bool USBPort::quiet() {
+    poll(); /* whatever is pending goes first */
+
+    uint32_t now = millis();
+    bool busy = usbRxLen != 0 ||        /* request waiting for usbPoll() */
+        !(usbTxLen & 0x10) ||           /* control data waiting for the host */
+        streamSent != 0 ||              /* interrupt report half out */
+        now - usbLastRx < USB_IDLE_MS;
+
+    if (!busy) {
+        deferring = 0;
+        return true;
+    }
+
+    if (!deferring) {
+        deferring = 1;
+        deferSince = now;
+    }
+    if (now - deferSince >= USB_DEFER_MAX) {
+        deferring = 0;
+        return true;
+    }
+    return false;
+}
+
+void USBPort::setSample(const Sample &s) {
+	liveSample = s;
+
+	uchar *p = streamBuf[streamFront ^ 1];
+	p[0] = USB_RID_STREAM;
+	memcpy(p + 1, &s, sizeof(Sample));
+	streamPending = 1;
 }
 
 USBPort::USBPort() {
@@ -8,10 +8,56 @@
 #ifndef USBPORT_H_
 #define USBPORT_H_
 
+#include "Sample.h"
+
+/*
+ * Reports, selected by report ID:
+ * 	USB_RID_EEPROM	feature, 128 byte wear leveled EEPROM block, read and write
+ * 	USB_RID_SAMPLE	feature, the current Sample, read only
+ * 	USB_RID_STREAM	input, every new Sample on the interrupt-in endpoint
+ */
+#define USB_RID_EEPROM	1
+#define USB_RID_SAMPLE	2
+#define USB_RID_STREAM	3
+
+/*
+ * Vendor requests on the control endpoint:
+ * 	USB_VREQ_LOG_SIZE	-> uint32_t size of the SD log
+ * 	USB_VREQ_LOG_READ	wValue: offset low, wIndex: offset high,
+ * 						wLength: bytes -> log contents, short at the end
+ * 	USB_VREQ_CFG_GET	wIndex: ConfigId -> uint32_t value
+ * 	USB_VREQ_CFG_SET	wIndex: ConfigId, data: uint32_t value
+ * Long transfers are enabled, so a single USB_VREQ_LOG_READ can move up to
+ * 65534 bytes.
+ */
+#define USB_VREQ_LOG_SIZE	1
+#define USB_VREQ_LOG_READ	2
+#define USB_VREQ_CFG_GET	3
+#define USB_VREQ_CFG_SET	4
+
+#define USB_LOG_AHEAD	64	// read ahead buffer for USB_VREQ_LOG_READ
+
+#define USB_EE_BASE		0	// USB_RID_EEPROM slots
+#define USB_EE_SIZE		128
+#define USB_EE_SLOTS	4
+
+/*
+ * quiet() arbitration. D+ is on INT0, so there are no SOF interrupts to
+ * time against; the host counts as quiet when no control transfer is under
+ * way, no interrupt-in report is half out and nothing was received for
+ * USB_IDLE_MS. Work is never put off for longer than USB_DEFER_MAX.
+ */
+#define USB_IDLE_MS		50ul
+#define USB_DEFER_MAX	2000ul
+
 class USBPort {
 public:
-	static void begin();
+	static void begin(const char *logFile);
 	static void poll();
+	static void setSample(const Sample &s);
+
+	// true when code that blocks interrupts or the loop may run now
+	static bool quiet();
 
 public:
 	USBPort();
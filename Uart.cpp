@@ -0,0 +1,137 @@
+/*
+ * Uart.cpp
+ *
+ *  See Uart.h.
+ */
+
+#include "Uart.h"
+
+#ifdef EN_UART
+#include <avr/interrupt.h>
+
+Uart Uart0;
+
+/*
+ * V-USB allows interrupts off for no more than 25 cycles, less than the
+ * prologue of a handler that calls into the rings. Both USART interrupts
+ * are level triggered, so ISR_NOBLOCK would come straight back: a naked
+ * stub masks the source and lets the others in, then jumps to the real
+ * handler, which unmasks on the way out.
+ */
+#ifdef __AVR__
+#define UART_ISR(vect, handler, ie)										\
+	extern "C" void handler(void) __attribute__((signal, used));		\
+	ISR(vect, ISR_NAKED) {												\
+		__asm__ __volatile__ (											\
+			"push r24"			"\n\t"									\
+			"in r24, __SREG__"	"\n\t"									\
+			"push r24"			"\n\t"									\
+			"lds r24, %0"		"\n\t"									\
+			"andi r24, %1"		"\n\t"									\
+			"sts %0, r24"		"\n\t"									\
+			"pop r24"			"\n\t"									\
+			"out __SREG__, r24"	"\n\t"									\
+			"pop r24"			"\n\t"									\
+			"sei"				"\n\t"									\
+			"jmp " #handler												\
+			:: "n" (_SFR_MEM_ADDR(UCSR0B)), "M" ((uint8_t)~_BV(ie)));	\
+	}																	\
+	extern "C" void handler(void)
+#else
+#define UART_ISR(vect, handler, ie)	ISR(vect)
+#endif
+
+UART_ISR(USART_RX_vect, __vector_uart_rx, RXCIE0) {
+	Uart0.rxIsr();
+	cli();
+	UCSR0B |= _BV(RXCIE0);
+}
+
+UART_ISR(USART_UDRE_vect, __vector_uart_udre, UDRIE0) {
+	if (Uart0.txIsr()) {
+		cli();
+		UCSR0B |= _BV(UDRIE0);
+	}
+}
+
+void Uart::rxIsr() {
+	uint8_t c = UDR0;	// read it even when there is no room, to clear RXC0
+	_rx.push(c);
+}
+
+/*
+ * Feed the data register, false once the ring is empty: the interrupt
+ * then stays off until kick().
+ */
+bool Uart::txIsr() {
+	uint8_t c;
+	if (!_tx.pop(c))
+		return false;
+	UDR0 = c;
+	return true;
+}
+
+/*
+ * Let the interrupt take what was queued. A handler that comes in between
+ * the read and the write here has put its enable bit back by the time it
+ * returns; UDRIE0 may then be set once too often, and the interrupt finds
+ * the ring empty.
+ */
+void Uart::kick() {
+	UCSR0B |= _BV(UDRIE0);
+}
+
+/*
+ * 8N1 at double speed, like the core.
+ */
+void Uart::begin(unsigned long baud) {
+	UCSR0A = _BV(U2X0);
+	UBRR0 = (F_CPU / 4 / baud - 1) / 2;
+	UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+	UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+void Uart::end() {
+	flush();
+	UCSR0B = 0;
+}
+
+int Uart::available() {
+	return _rx.count();
+}
+
+int Uart::read() {
+	uint8_t c;
+	return _rx.pop(c) ? c : -1;
+}
+
+int Uart::peek() {
+	uint8_t c;
+	return _rx.peek(c) ? c : -1;
+}
+
+void Uart::flush() {
+	if (!(UCSR0B & _BV(TXEN0)))
+		return;
+	while (_tx.count()) {
+		// nobody else will empty it with interrupts off
+		if (!(SREG & _BV(SREG_I)) && (UCSR0A & _BV(UDRE0))) {
+			txIsr();
+		}
+	}
+	while (!(UCSR0A & _BV(UDRE0)))
+		;
+}
+
+size_t Uart::write(uint8_t c) {
+	while (!_tx.space()) {
+		if (!(SREG & _BV(SREG_I)) && (UCSR0A & _BV(UDRE0))) {
+			txIsr();
+		}
+	}
+	_tx.push(c);
+	kick();
+	return 1;
+}
+
+#endif /* EN_UART */
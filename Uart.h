@@ -0,0 +1,84 @@
+/*
+ * Uart.h
+ *
+ *  USART0 driver for EN_UART builds, in place of the core's Serial.
+ *  Both directions go through a Ring between the loop and the USART
+ *  interrupts, so neither side turns interrupts off.
+ *
+ *  Bytes that arrive while the RX ring is full are counted and lost.
+ *  write() only waits when the TX ring is full, which suits replies that
+ *  must go out whole. Telemetry checks txFree() first, see CONSOLE_FITS,
+ *  and holds back rather than wait.
+ *
+ *  The core's HardwareSerial must then not be linked, as it brings its own
+ *  USART interrupt handlers: use CONSOLE rather than Serial.
+ */
+
+#ifndef UART_H_
+#define UART_H_
+#if ARDUINO >= 100
+ #include "Arduino.h"
+#else
+ #include "WProgram.h"
+#endif
+
+#ifdef EN_UART
+
+#include "Ring.h"
+
+#ifndef UART_RX_SIZE
+#define UART_RX_SIZE	64	// power of two, see Ring.h
+#endif
+#ifndef UART_TX_SIZE
+#define UART_TX_SIZE	128
+#endif
+
+class Uart : public Stream {
+public:
+	Uart() {
+	}
+
+	void begin(unsigned long baud);
+	void end();
+
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+	virtual void flush();
+	virtual size_t write(uint8_t c);
+	using Print::write;
+
+	operator bool() {
+		return true;
+	}
+
+	// bytes write() can take without waiting
+	uint8_t txFree() const {
+		return _tx.space();
+	}
+
+	// bytes lost because the loop did not read them in time
+	uint16_t rxDrops() const {
+		return _rx.drops();
+	}
+
+	void rxIsr();
+	bool txIsr();
+
+private:
+	void kick();
+
+	Ring<uint8_t, UART_RX_SIZE> _rx;
+	Ring<uint8_t, UART_TX_SIZE> _tx;
+};
+
+extern Uart Uart0;
+
+#define CONSOLE			Uart0
+#define CONSOLE_FITS(n)	(Uart0.txFree() >= (n))
+#else
+#define CONSOLE			Serial
+#define CONSOLE_FITS(n)	true	// no way to tell, write() waits
+#endif
+
+#endif /* UART_H_ */
@@ -0,0 +1,134 @@
+/*
+ * BenchHal.cpp
+ *
+ *  The host/Hal.h functions for the benchmark firmware, on the real
+ *  ATmega328P peripherals as simavr models them. Time is Timer1, set up by
+ *  Prof::begin(), so it wraps after 2^32 cycles (268 s); a benchmark run is
+ *  far shorter. Pins read high, the DSM501 sees clean air.
+ */
+
+#include "Arduino.h"
+#include "Hal.h"
+#include "Prof.h"
+
+/***********************************************
+ * C++ runtime, normally from the Arduino core
+ ***********************************************/
+extern "C" void __cxa_pure_virtual() {
+	for (;;)
+		;
+}
+
+void operator delete(void *p) {
+	free(p);
+}
+
+/***********************************************
+ * Time
+ ***********************************************/
+uint64_t halMicros() {
+	return Prof::now() / (F_CPU / 1000000ul);
+}
+
+/* the stand-in drivers cost what their code costs */
+void halSpend(uint32_t us) {
+	(void)us;
+}
+
+unsigned long millis() {
+	return Prof::now() / (F_CPU / 1000ul);
+}
+
+unsigned long micros() {
+	return Prof::now() / (F_CPU / 1000000ul);
+}
+
+void delay(unsigned long ms) {
+	uint32_t start = Prof::now();
+	while (Prof::now() - start < ms * (F_CPU / 1000ul))
+		;
+}
+
+void delayMicroseconds(unsigned int us) {
+	uint32_t start = Prof::now();
+	while (Prof::now() - start < us * (F_CPU / 1000000ul))
+		;
+}
+
+/***********************************************
+ * Pins
+ ***********************************************/
+static uint8_t pinLevel[HAL_PINS];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	if (pin < HAL_PINS && mode != OUTPUT) {
+		pinLevel[pin] = HIGH;
+	}
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+	if (pin < HAL_PINS) {
+		pinLevel[pin] = val ? HIGH : LOW;
+	}
+}
+
+int digitalRead(uint8_t pin) {
+	return pin < HAL_PINS ? pinLevel[pin] : LOW;
+}
+
+/***********************************************
+ * UART0, polled
+ ***********************************************/
+HardwareSerial Serial;
+
+static int rxPeek = -1;
+
+void HardwareSerial::begin(unsigned long baud) {
+	UCSR0A = _BV(U2X0);
+	UBRR0 = (F_CPU / 8 / baud) - 1;
+	UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+	UCSR0B = _BV(RXEN0) | _BV(TXEN0);
+}
+
+void HardwareSerial::end() {
+	flush();
+	UCSR0B = 0;
+}
+
+int HardwareSerial::available() {
+	return rxPeek >= 0 || (UCSR0A & _BV(RXC0));
+}
+
+int HardwareSerial::read() {
+	int c = peek();
+	rxPeek = -1;
+	return c;
+}
+
+int HardwareSerial::peek() {
+	if (rxPeek < 0 && (UCSR0A & _BV(RXC0))) {
+		rxPeek = UDR0;
+	}
+	return rxPeek;
+}
+
+void HardwareSerial::flush() {
+	if (!(UCSR0B & _BV(TXEN0)))
+		return;
+	while (!(UCSR0A & _BV(UDRE0)))
+		;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	while (!(UCSR0A & _BV(UDRE0)))
+		;
+	UDR0 = c;
+	return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		write(buf[i]);
+	}
+	return n;
+}
@@ -0,0 +1,187 @@
+/*
+ * BenchLib.cpp
+ *
+ *  DHT22, LCD and SD for the benchmark firmware, declared in host/. They
+ *  do no I/O, so a benchmark measures the firmware's own code. The SD card
+ *  takes any number of bytes and counts them.
+ */
+
+#include "DHT22.h"
+#include "LiquidCrystal.h"
+#include "SD.h"
+
+/***********************************************
+ * DHT22
+ ***********************************************/
+DHT22::DHT22(uint8_t pin) : _pin(pin) {
+}
+
+float DHT22::readTemperature() {
+	return 22.5f;
+}
+
+float DHT22::readHumidity() {
+	return 45.0f;
+}
+
+/***********************************************
+ * LiquidCrystal
+ ***********************************************/
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t en,
+		uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+	(void)rs; (void)rw; (void)en;
+	(void)d4; (void)d5; (void)d6; (void)d7;
+	init();
+}
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t en,
+		uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+	(void)rs; (void)en;
+	(void)d4; (void)d5; (void)d6; (void)d7;
+	init();
+}
+
+void LiquidCrystal::init() {
+	_cols = 16;
+	_rows = 2;
+	_col = _row = 0;
+	memset(_screen, 0, sizeof(_screen));
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows) {
+	_cols = cols > LCD_COLS_MAX ? LCD_COLS_MAX : cols;
+	_rows = rows > LCD_ROWS_MAX ? LCD_ROWS_MAX : rows;
+	clear();
+}
+
+void LiquidCrystal::clear() {
+	for (uint8_t r = 0; r < LCD_ROWS_MAX; r++) {
+		memset(_screen[r], ' ', _cols);
+		_screen[r][_cols] = 0;
+	}
+	home();
+}
+
+void LiquidCrystal::home() {
+	_col = _row = 0;
+}
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row) {
+	_col = col;
+	_row = row < _rows ? row : _rows - 1;
+}
+
+size_t LiquidCrystal::write(uint8_t c) {
+	if (_col < _cols) {
+		_screen[_row][_col] = c;
+	}
+	_col++;
+	return 1;
+}
+
+const char *LiquidCrystal::row(uint8_t r) const {
+	return _screen[r < _rows ? r : 0];
+}
+
+void LiquidCrystal::service() {
+}
+
+/***********************************************
+ * SD
+ ***********************************************/
+SDClass SD;
+
+static FILE sdSink;			// marks a File as open
+static uint32_t sdBytes;
+
+File::File() : _f(0), _mode(0) {
+	_name[0] = 0;
+}
+
+size_t File::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t n) {
+	(void)buf;
+	if (!_f)
+		return 0;
+	sdBytes += n;
+	return n;
+}
+
+int File::available() {
+	return 0;
+}
+
+int File::read() {
+	return -1;
+}
+
+int File::peek() {
+	return -1;
+}
+
+void File::flush() {
+}
+
+int File::read(void *buf, uint16_t n) {
+	(void)buf;
+	(void)n;
+	return _f ? 0 : -1;
+}
+
+bool File::seek(uint32_t pos) {
+	return _f && pos <= sdBytes;
+}
+
+uint32_t File::position() {
+	return sdBytes;
+}
+
+uint32_t File::size() {
+	return sdBytes;
+}
+
+void File::close() {
+	_f = 0;
+}
+
+const char *File::name() {
+	return _name;
+}
+
+File::operator bool() {
+	return _f != 0;
+}
+
+bool SDClass::begin(uint8_t csPin) {
+	(void)csPin;
+	_ok = true;
+	return true;
+}
+
+void SDClass::end() {
+	_ok = false;
+}
+
+File SDClass::open(const char *path, uint8_t mode) {
+	(void)mode;
+	File file;
+	if (_ok) {
+		file._f = &sdSink;
+		strncpy(file._name, path, sizeof(file._name) - 1);
+		file._name[sizeof(file._name) - 1] = 0;
+	}
+	return file;
+}
+
+bool SDClass::exists(const char *path) {
+	(void)path;
+	return _ok;
+}
+
+bool SDClass::remove(const char *path) {
+	(void)path;
+	return _ok;
+}
@@ -0,0 +1,132 @@
+/*
+ * bench.cpp
+ *
+ *  Benchmark firmware, run under simavr by simbench. Each case runs a
+ *  number of times between two Timer1 reads (see Prof.h), the cost of the
+ *  reads themselves taken out, and the results go out on the UART as one
+ *  JSON document. The CPU then sleeps with interrupts off, which ends the
+ *  simulation.
+ */
+
+#include "Arduino.h"
+#include "Config.h"
+#include "DS1307.h"
+#include "DSM501.h"
+#include "LiquidCrystal.h"
+#include "SD.h"
+#include "Sample.h"
+#include "SdLog.h"
+#include "SoftClock.h"
+#include "Prof.h"
+#include <avr/sleep.h>
+
+/* from AirQ.cpp */
+extern Sample cur;
+extern DS1307 ds1307;
+extern SoftClock softClock;
+extern DSM501 dsm501;
+extern LiquidCrystal lcd;
+extern SdLog sdLog;
+extern uint8_t lastRecValid;
+void readSample(Sample &s);
+int genReports(char *buf, uint8_t size, const Sample &s, bool detail);
+void log2Sd();
+void loop();
+
+struct BenchResult {
+	uint16_t runs;
+	uint32_t min;
+	uint32_t max;
+	uint32_t total;
+};
+
+static uint32_t overhead;
+static char buf[64];
+static uint8_t first = 1;
+
+static void report(const char *name, const BenchResult &r) {
+	Serial.print(first ? "\n  " : ",\n  ");
+	first = 0;
+	Serial.print("{\"name\": \"");
+	Serial.print(name);
+	Serial.print("\", \"runs\": ");
+	Serial.print(r.runs);
+	Serial.print(", \"min\": ");
+	Serial.print(r.min);
+	Serial.print(", \"mean\": ");
+	Serial.print(r.total / r.runs);
+	Serial.print(", \"max\": ");
+	Serial.print(r.max);
+	Serial.print("}");
+}
+
+/*
+ * Time fn() runs times, in cycles.
+ */
+template<class Fn> static void bench(const char *name, uint16_t runs, Fn fn) {
+	BenchResult r = { runs, 0xfffffffful, 0, 0 };
+
+	for (uint16_t i = 0; i < runs; i++) {
+		uint32_t t = Prof::now();
+		fn();
+		t = Prof::now() - t - overhead;
+		if (t < r.min) {
+			r.min = t;
+		}
+		if (t > r.max) {
+			r.max = t;
+		}
+		r.total += t;
+	}
+	report(name, r);
+}
+
+static void calibrate() {
+	overhead = 0xfffffffful;
+	for (uint8_t i = 0; i < 16; i++) {
+		uint32_t t = Prof::now();
+		t = Prof::now() - t;
+		if (t < overhead) {
+			overhead = t;
+		}
+	}
+}
+
+int main() {
+	Prof::begin();
+	sei();
+
+	Serial.begin(115200);
+	config.begin();
+	dsm501.begin();
+	ds1307.begin();
+	softClock.begin();
+	lcd.begin(16, 2);
+	sdLog.begin();
+	readSample(cur);
+
+	/* every log2Sd() call writes a record */
+	config.data.logDeadband = 0;
+
+	calibrate();
+
+	Serial.print("{\"target\": \"atmega328p\", \"f_cpu\": ");
+	Serial.print(F_CPU);
+	Serial.print(", \"unit\": \"cycles\", \"results\": [");
+
+	bench("genReports", 100, [] { genReports(buf, sizeof(buf), cur, false); });
+	bench("genReports_detail", 100, [] { genReports(buf, sizeof(buf), cur, true); });
+	bench("DSM501::getAQI", 100, [] { dsm501.getAQI(); });
+	bench("DS1307::makeStr", 100, [] { ds1307.makeStr(buf, 32); });
+	bench("log2Sd", 50, [] { lastRecValid = 0; log2Sd(); });
+	bench("loop", 2000, [] { loop(); });
+
+	Serial.println("\n]}");
+	Serial.flush();
+
+	cli();
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	sleep_enable();
+	sleep_cpu();
+	return 0;
+}
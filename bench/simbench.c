@@ -0,0 +1,87 @@
+/*
+ * simbench.c
+ *
+ *  Runs the benchmark firmware on simavr's ATmega328P at 16 MHz and copies
+ *  what it sends on UART0 to stdout or out.json. Exits 0 once the firmware
+ *  has gone to sleep with interrupts off, 1 if it crashed or ran out of
+ *  cycles.
+ *
+ *  usage: simbench bench.elf [out.json [max_cycles]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_uart.h>
+
+#define SIM_MCU		"atmega328p"
+#define SIM_F_CPU	16000000ul
+#define SIM_MAX		(SIM_F_CPU * 600ull)	/* ten simulated minutes */
+
+static void uartOut(struct avr_irq_t *irq, uint32_t value, void *param) {
+	(void)irq;
+	fputc((int)value, (FILE *)param);
+}
+
+int main(int argc, char **argv) {
+	elf_firmware_t fw = { { 0 } };
+	unsigned long long maxCycles = SIM_MAX;
+	FILE *out = stdout;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s bench.elf [out.json [max_cycles]]\n", argv[0]);
+		return 2;
+	}
+	if (argc > 2 && strcmp(argv[2], "-")) {
+		out = fopen(argv[2], "w");
+		if (!out) {
+			perror(argv[2]);
+			return 2;
+		}
+	}
+	if (argc > 3) {
+		maxCycles = strtoull(argv[3], 0, 0);
+	}
+
+	if (elf_read_firmware(argv[1], &fw)) {
+		fprintf(stderr, "%s: cannot load\n", argv[1]);
+		return 2;
+	}
+
+	avr_t *avr = avr_make_mcu_by_name(SIM_MCU);
+	if (!avr) {
+		fprintf(stderr, "simavr has no %s\n", SIM_MCU);
+		return 2;
+	}
+	avr_init(avr);
+	avr_load_firmware(avr, &fw);
+	avr->frequency = SIM_F_CPU;
+
+	/* take the UART bytes ourselves instead of simavr's line printer */
+	uint32_t flags = 0;
+	avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+	flags &= ~AVR_UART_FLAG_STDIO;
+	avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+	avr_irq_register_notify(
+			avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+			uartOut, out);
+
+	int state = cpu_Running;
+	while (state != cpu_Done && state != cpu_Crashed) {
+		if (avr->cycle > maxCycles) {
+			fprintf(stderr, "no result after %llu cycles\n", maxCycles);
+			return 1;
+		}
+		state = avr_run(avr);
+	}
+	fclose(out);
+
+	if (state == cpu_Crashed) {
+		fprintf(stderr, "firmware crashed at pc 0x%04x\n", avr->pc);
+		return 1;
+	}
+	return 0;
+}
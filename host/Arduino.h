@@ -0,0 +1,153 @@
+/*
+ * Arduino.h
+ *
+ *  Host stand-in for the Arduino core, enough of it to build the sketch as a
+ *  Linux program. Time, pins, the UART and the EEPROM are simulated by
+ *  Hal.cpp, see Hal.h for how they are driven.
+ */
+
+#ifndef ARDUINO_H_
+#define ARDUINO_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+
+#ifndef F_CPU
+#define F_CPU		16000000ul
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH		1
+#define LOW			0
+
+#define INPUT		0
+#define OUTPUT		1
+#define INPUT_PULLUP 2
+
+#define DEC			10
+#define HEX			16
+#define OCT			8
+#define BIN			2
+
+/* ATmega328P pin numbers */
+#define HAL_PINS	20
+
+enum {
+	A0 = 14, A1, A2, A3, A4, A5
+};
+
+#define SS			10
+#define MOSI		11
+#define MISO		12
+#define SCK			13
+#define SDA			18
+#define SCL			19
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+/* avr-libc */
+char *dtostrf(double val, signed char width, unsigned char prec, char *s);
+
+class __FlashStringHelper;
+#define F(s)	(reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+class Print {
+public:
+	Print() : _writeError(0) {}
+	virtual ~Print() {}
+
+	int getWriteError() {
+		return _writeError;
+	}
+	void clearWriteError() {
+		_writeError = 0;
+	}
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buf, size_t n);
+	size_t write(const char *s) {
+		return s ? write((const uint8_t *)s, strlen(s)) : 0;
+	}
+
+	size_t print(const __FlashStringHelper *s);
+	size_t print(const char s[]);
+	size_t print(char c);
+	size_t print(unsigned char n, int base = DEC);
+	size_t print(int n, int base = DEC);
+	size_t print(unsigned int n, int base = DEC);
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t print(double n, int digits = 2);
+
+	size_t println(const __FlashStringHelper *s);
+	size_t println(const char s[]);
+	size_t println(char c);
+	size_t println(unsigned char n, int base = DEC);
+	size_t println(int n, int base = DEC);
+	size_t println(unsigned int n, int base = DEC);
+	size_t println(long n, int base = DEC);
+	size_t println(unsigned long n, int base = DEC);
+	size_t println(double n, int digits = 2);
+	size_t println();
+
+protected:
+	void setWriteError(int err = 1) {
+		_writeError = err;
+	}
+
+private:
+	size_t printNumber(unsigned long n, uint8_t base);
+	size_t printFloat(double n, uint8_t digits);
+
+	int _writeError;
+};
+
+class Stream : public Print {
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	virtual void flush() = 0;
+};
+
+/*
+ * The UART, see Hal.h for where its bytes come from and go to.
+ */
+class HardwareSerial : public Stream {
+public:
+	void begin(unsigned long baud);
+	void end();
+
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+	virtual void flush();
+	virtual size_t write(uint8_t c);
+	virtual size_t write(const uint8_t *buf, size_t n);
+	using Print::write;
+
+	operator bool() {
+		return true;
+	}
+};
+
+extern HardwareSerial Serial;
+
+#endif /* ARDUINO_H_ */
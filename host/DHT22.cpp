@@ -0,0 +1,29 @@
+/*
+ * DHT22.cpp
+ *
+ *  See DHT22.h. Every read costs the time of a real transfer, start
+ *  pulse and 40 bits, during which the AVR has interrupts off.
+ */
+
+#include "DHT22.h"
+#include "Hal.h"
+
+#define DHT22_READ_US	5000u
+
+static float envValue(const char *name, float def) {
+	const char *v = getenv(name);
+	return v ? strtof(v, 0) : def;
+}
+
+DHT22::DHT22(uint8_t pin) : _pin(pin) {
+}
+
+float DHT22::readTemperature() {
+	halSpend(DHT22_READ_US);
+	return envValue("AQI_TEMP", 22.5f);
+}
+
+float DHT22::readHumidity() {
+	halSpend(DHT22_READ_US);
+	return envValue("AQI_HUMI", 45.0f);
+}
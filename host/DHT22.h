@@ -0,0 +1,24 @@
+/*
+ * DHT22.h
+ *
+ *  Host DHT22, reads AQI_TEMP and AQI_HUMI. Set either to "nan" to make
+ *  the sensor fail.
+ */
+
+#ifndef DHT22_H_
+#define DHT22_H_
+
+#include "Arduino.h"
+
+class DHT22 {
+public:
+	DHT22(uint8_t pin);
+
+	float readTemperature();
+	float readHumidity();
+
+private:
+	uint8_t _pin;
+};
+
+#endif /* DHT22_H_ */
@@ -0,0 +1,306 @@
+/*
+ * DsmSim.cpp
+ *
+ *  See DsmSim.h.
+ */
+
+#include "DsmSim.h"
+#include "Hal.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DSMSIM_GLITCH_MS	9.0		// longest bounce, under DSM501_MIN_SIG_SPAN
+#define DSMSIM_LONG_MIN_MS	90.0
+#define DSMSIM_LONG_MAX_MS	300.0
+#define DSMSIM_NEVER		UINT64_MAX
+
+enum {
+	PH_GAP,
+	PH_GLITCH,
+	PH_GLITCH_GAP,
+	PH_PULSE,
+};
+
+DsmSim::DsmSim() : _record(0) {
+	params.occ[0] = 5.0;
+	params.occ[1] = 2.0;
+	params.pulseMs = 30.0;
+	params.jitter = 0.2;
+	params.bounce = 0.0;
+	params.longP = 0.0;
+	params.swing = 0.0;
+	params.periodS = 86400.0;
+	params.seed = 1;
+	params.trace = 0;
+	params.record = 0;
+	memset(_ch, 0, sizeof(_ch));
+}
+
+bool DsmSim::config(const char *settings) {
+	char *buf = strdup(settings), *save;
+	bool ok = true;
+
+	for (char *kv = strtok_r(buf, ",", &save); kv; kv = strtok_r(0, ",", &save)) {
+		char *v = strchr(kv, '=');
+		if (!v) {
+			fprintf(stderr, "dsmsim: %s: expected key=value\n", kv);
+			ok = false;
+			continue;
+		}
+		*v++ = 0;
+
+		if (!strcmp(kv, "occ10")) {
+			params.occ[0] = atof(v);
+		} else if (!strcmp(kv, "occ25")) {
+			params.occ[1] = atof(v);
+		} else if (!strcmp(kv, "pulse")) {
+			params.pulseMs = atof(v);
+		} else if (!strcmp(kv, "jitter")) {
+			params.jitter = atof(v);
+		} else if (!strcmp(kv, "bounce")) {
+			params.bounce = atof(v);
+		} else if (!strcmp(kv, "long")) {
+			params.longP = atof(v);
+		} else if (!strcmp(kv, "swing")) {
+			params.swing = atof(v);
+		} else if (!strcmp(kv, "period")) {
+			params.periodS = atof(v);
+		} else if (!strcmp(kv, "seed")) {
+			params.seed = strtoul(v, 0, 0);
+		} else if (!strcmp(kv, "trace")) {
+			params.trace = strdup(v);
+		} else if (!strcmp(kv, "record")) {
+			params.record = strdup(v);
+		} else {
+			fprintf(stderr, "dsmsim: unknown setting %s\n", kv);
+			ok = false;
+		}
+	}
+
+	free(buf);
+	return ok;
+}
+
+bool DsmSim::loadTrace() {
+	FILE *f = fopen(params.trace, "r");
+	if (!f) {
+		perror(params.trace);
+		return false;
+	}
+
+	char line[128];
+	unsigned n = 0;
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long us;
+		unsigned ch, level;
+
+		n++;
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == 0)
+			continue;
+		if (sscanf(line, "%llu %u %u", &us, &ch, &level) != 3 ||
+				ch >= DSMSIM_CHANNELS) {
+			fprintf(stderr, "%s:%u: expected <us> <channel> <level>\n",
+					params.trace, n);
+			fclose(f);
+			return false;
+		}
+
+		std::vector<TraceEdge> &t = _trace[ch];
+		if (!t.empty() && us < t.back().us) {
+			fprintf(stderr, "%s:%u: time goes backwards\n", params.trace, n);
+			fclose(f);
+			return false;
+		}
+		TraceEdge e = { us, (uint8_t)(level ? 1 : 0) };
+		t.push_back(e);
+	}
+
+	fclose(f);
+	return true;
+}
+
+bool DsmSim::begin(uint8_t pin10, uint8_t pin25) {
+	if (params.trace && !loadTrace())
+		return false;
+
+	if (params.record) {
+		_record = fopen(params.record, "w");
+		if (!_record) {
+			perror(params.record);
+			return false;
+		}
+		fprintf(_record, "# <us> <channel> <level>\n");
+	}
+
+	for (uint8_t i = 0; i < DSMSIM_CHANNELS; i++) {
+		Channel &c = _ch[i];
+		c.pin = i ? pin25 : pin10;
+		c.level = 1;
+		c.noise = false;
+		c.since = 0;
+		c.trueLow = c.rawLow = 0;
+		c.rng = ((uint64_t)params.seed << 8) + i + 1;
+		c.pos = 0;
+		c.phase = PH_GAP;
+		nextSegment(i);
+	}
+	return true;
+}
+
+void DsmSim::end() {
+	if (_record) {
+		fclose(_record);
+		_record = 0;
+	}
+}
+
+/*
+ * splitmix64, uniform in [0, 1)
+ */
+double DsmSim::random(Channel &c) {
+	uint64_t z = (c.rng += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	z ^= z >> 31;
+	return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double DsmSim::occupancy(uint8_t ch, uint64_t us) {
+	double occ = params.occ[ch];
+	if (params.swing != 0.0 && params.periodS > 0.0) {
+		occ *= 1.0 + params.swing * sin(2.0 * M_PI * (us / 1e6) / params.periodS);
+	}
+	if (occ < 0.0)
+		return 0.0;
+	return occ > 99.0 ? 99.0 : occ;
+}
+
+/*
+ * Work out the segment that starts at c.since, and set c.edge to its end.
+ */
+void DsmSim::nextSegment(uint8_t ch) {
+	Channel &c = _ch[ch];
+
+	if (params.trace) {
+		std::vector<TraceEdge> &t = _trace[ch];
+		while (c.pos < t.size() && t[c.pos].level == c.level) {
+			c.pos++;	// repeated level, not an edge
+		}
+		c.noise = false;
+		c.edge = c.pos < t.size() ? t[c.pos].us : DSMSIM_NEVER;
+		if (c.pos < t.size()) {
+			c.pos++;
+		}
+		return;
+	}
+
+	double ms;
+	switch (c.phase) {
+	case PH_GAP: {
+		double occ = occupancy(ch, c.since) / 100.0;
+		c.level = 1;
+		c.noise = false;
+		if (occ <= 0.0) {
+			ms = 1000.0;	// clean air, look again in a second
+			break;
+		}
+		ms = -params.pulseMs * (1.0 - occ) / occ * log(1.0 - random(c));
+		c.phase = random(c) < params.bounce ? PH_GLITCH : PH_PULSE;
+		break;
+	}
+	case PH_GLITCH:
+		ms = 1.0 + random(c) * (DSMSIM_GLITCH_MS - 1.0);
+		c.level = 0;
+		c.noise = true;
+		c.phase = PH_GLITCH_GAP;
+		break;
+	case PH_GLITCH_GAP:
+		ms = 1.0 + random(c) * 4.0;
+		c.level = 1;
+		c.noise = false;
+		c.phase = PH_PULSE;
+		break;
+	default:
+		if (random(c) < params.longP) {
+			ms = DSMSIM_LONG_MIN_MS +
+				random(c) * (DSMSIM_LONG_MAX_MS - DSMSIM_LONG_MIN_MS);
+		} else {
+			ms = params.pulseMs * (1.0 + params.jitter * (2.0 * random(c) - 1.0));
+		}
+		c.level = 0;
+		c.noise = false;
+		c.phase = PH_GAP;
+		break;
+	}
+
+	uint64_t us = ms < 0.001 ? 1 : (uint64_t)(ms * 1000.0);
+	c.edge = c.since + us;
+}
+
+void DsmSim::advance(uint8_t ch, uint64_t us) {
+	Channel &c = _ch[ch];
+
+	while (c.edge <= us) {
+		uint64_t span = c.edge - c.since;
+		if (c.level == 0) {
+			c.rawLow += span;
+			if (!c.noise) {
+				c.trueLow += span;
+			}
+		}
+
+		c.since = c.edge;
+		if (params.trace) {
+			c.level ^= 1;
+		}
+		nextSegment(ch);
+
+		if (_record) {
+			fprintf(_record, "%llu %u %u\n", (unsigned long long)c.since,
+					ch, c.level);
+		}
+	}
+}
+
+uint8_t DsmSim::level(uint8_t ch, uint64_t us) {
+	advance(ch, us);
+	return _ch[ch].level;
+}
+
+uint64_t DsmSim::nextEdge() {
+	uint64_t e = DSMSIM_NEVER;
+	for (uint8_t i = 0; i < DSMSIM_CHANNELS; i++) {
+		if (_ch[i].edge < e) {
+			e = _ch[i].edge;
+		}
+	}
+	return e;
+}
+
+uint64_t DsmSim::trueLow(uint8_t ch, uint64_t us) {
+	Channel &c = _ch[ch];
+	advance(ch, us);
+	return c.trueLow + (c.level == 0 && !c.noise ? us - c.since : 0);
+}
+
+uint64_t DsmSim::rawLow(uint8_t ch, uint64_t us) {
+	Channel &c = _ch[ch];
+	advance(ch, us);
+	return c.rawLow + (c.level == 0 ? us - c.since : 0);
+}
+
+static DsmSim *attached;
+
+static int pinSource(uint8_t pin, uint64_t us) {
+	for (uint8_t i = 0; i < DSMSIM_CHANNELS; i++) {
+		if (attached->pin(i) == pin)
+			return attached->level(i, us);
+	}
+	return -1;
+}
+
+void DsmSim::attach() {
+	attached = this;
+	halSetPinSource(pinSource);
+}
@@ -0,0 +1,110 @@
+/*
+ * DsmSim.h
+ *
+ *  DSM501 output simulator for the host build. Each channel is a pulse
+ *  train drawn from a seeded generator, so a run is repeatable:
+ *
+ *  	high gap (exponential, sized for the occupancy at that time)
+ *  	[bounce: low glitch under DSM501_MIN_SIG_SPAN, short high]
+ *  	low pulse, `pulse` ms +- jitter, or with probability `long` an
+ *  	over-long pulse of 90-300 ms
+ *
+ *  or the edges come from a trace file, one "<us> <channel> <level>" per
+ *  line. Ground truth is kept as the low time of real pulses, glitches left
+ *  out; for traces it is all of the low time.
+ *
+ *  Settings are a comma separated list of key=value:
+ *
+ *  occ10, occ25	occupancy in %, default 5 and 2
+ *  pulse			mean pulse length in ms, default 30
+ *  jitter			pulse length spread, fraction of pulse, default 0.2
+ *  bounce			probability of a glitch before a pulse, default 0
+ *  long			probability of an over-long pulse, default 0
+ *  swing, period	occupancy follows occ * (1 + swing * sin(2 pi t / period)),
+ *  				period in s, default no swing and one day
+ *  seed			default 1
+ *  trace			play this file instead of generating
+ *  record			write the edges seen to this file, same format
+ */
+
+#ifndef DSMSIM_H_
+#define DSMSIM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#define DSMSIM_CHANNELS	2
+
+struct DsmSimParams {
+	double occ[DSMSIM_CHANNELS];	// %
+	double pulseMs;
+	double jitter;
+	double bounce;
+	double longP;
+	double swing;
+	double periodS;
+	uint32_t seed;
+	const char *trace;
+	const char *record;
+};
+
+class DsmSim {
+public:
+	DsmSim();
+
+	// parse key=value settings, false and a message on stderr if one is bad
+	bool config(const char *settings);
+	bool begin(uint8_t pin10, uint8_t pin25);
+	void end();
+
+	// level of a channel at us, times must not go backwards
+	uint8_t level(uint8_t ch, uint64_t us);
+
+	// time of the next edge on any channel after the last level() call
+	uint64_t nextEdge();
+
+	// low time up to us
+	uint64_t trueLow(uint8_t ch, uint64_t us);
+	uint64_t rawLow(uint8_t ch, uint64_t us);
+
+	uint8_t pin(uint8_t ch) const {
+		return _ch[ch].pin;
+	}
+
+	// drive the pins through halSetPinSource()
+	void attach();
+
+	DsmSimParams params;
+
+private:
+	struct Channel {
+		uint8_t  pin;
+		uint8_t  level;
+		uint8_t  phase;
+		bool     noise;		// the current low segment is a glitch
+		uint64_t since;		// start of the current segment
+		uint64_t edge;		// end of the current segment
+		uint64_t trueLow;	// up to since
+		uint64_t rawLow;
+		uint64_t rng;
+		size_t   pos;		// next trace edge
+	};
+
+	struct TraceEdge {
+		uint64_t us;
+		uint8_t  level;
+	};
+
+	void advance(uint8_t ch, uint64_t us);
+	void nextSegment(uint8_t ch);
+	bool loadTrace();
+	double random(Channel &c);
+	double occupancy(uint8_t ch, uint64_t us);
+
+	Channel _ch[DSMSIM_CHANNELS];
+	std::vector<TraceEdge> _trace[DSMSIM_CHANNELS];
+	FILE *_record;
+};
+
+#endif /* DSMSIM_H_ */
@@ -0,0 +1,391 @@
+/*
+ * Hal.cpp
+ *
+ *  Simulated time, pins, EEPROM and UART for the host build, see Hal.h.
+ */
+
+#include "Arduino.h"
+#include "Hal.h"
+#include "LiquidCrystal.h"
+#include <avr/eeprom.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/***********************************************
+ * Time
+ ***********************************************/
+static double	speed = 1.0;
+static uint32_t	loopUs = 100;
+static uint64_t	runUs;			// 0 = run forever
+static uint64_t	wallStart;
+static uint64_t	spent;			// virtual time, or time spent in halSpend()
+
+static uint64_t wallMicros() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000u;
+}
+
+uint64_t halMicros() {
+	if (speed <= 0.0)
+		return spent;
+	return (uint64_t)((wallMicros() - wallStart) * speed) + spent;
+}
+
+void halSetSpeed(double s) {
+	speed = s;
+	spent = 0;
+	wallStart = wallMicros();
+}
+
+void halSpend(uint32_t us) {
+	spent += us;
+}
+
+unsigned long millis() {
+	return (unsigned long)(halMicros() / 1000u);
+}
+
+unsigned long micros() {
+	return (unsigned long)halMicros();
+}
+
+static void service();
+
+/*
+ * Interrupts keep being served while waiting, like on the AVR.
+ */
+static void wait(uint64_t us) {
+	uint64_t end = halMicros() + us;
+
+	for (uint64_t now = halMicros(); now < end; now = halMicros()) {
+		uint64_t step = end - now < 1000u ? end - now : 1000u;
+		if (speed <= 0.0) {
+			spent += step;
+		} else {
+			usleep((useconds_t)(step / speed));
+		}
+		service();
+	}
+}
+
+void delay(unsigned long ms) {
+	wait((uint64_t)ms * 1000u);
+}
+
+void delayMicroseconds(unsigned int us) {
+	wait(us);
+}
+
+bool halDone() {
+	return runUs && halMicros() >= runUs;
+}
+
+/***********************************************
+ * Pins
+ ***********************************************/
+static uint8_t		pinLevel[HAL_PINS];
+static uint8_t		pinDir[HAL_PINS];
+static HalPinSource	pinSource;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	if (pin >= HAL_PINS)
+		return;
+
+	pinDir[pin] = mode;
+	if (mode == INPUT_PULLUP) {
+		pinLevel[pin] = HIGH;
+	}
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+	if (pin < HAL_PINS) {
+		pinLevel[pin] = val ? HIGH : LOW;
+	}
+}
+
+int digitalRead(uint8_t pin) {
+	if (pin >= HAL_PINS)
+		return LOW;
+
+	if (pinSource && pinDir[pin] != OUTPUT) {
+		int v = pinSource(pin, halMicros());
+		if (v >= 0)
+			return v ? HIGH : LOW;
+	}
+	return pinLevel[pin];
+}
+
+void halSetPin(uint8_t pin, uint8_t level) {
+	digitalWrite(pin, level);
+}
+
+void halSetPinSource(HalPinSource src) {
+	pinSource = src;
+}
+
+/***********************************************
+ * EEPROM
+ ***********************************************/
+volatile uint8_t EECR;
+volatile uint8_t EEDR;
+volatile uint16_t EEAR;
+
+extern "C" void EE_READY_vect(void) __attribute__((weak));
+
+static uint8_t	eeMem[E2END + 1];
+static FILE		*eeFile;
+
+static void eeOpen() {
+	const char *name = getenv("AQI_EEPROM");
+	if (!name) {
+		name = "eeprom.bin";
+	}
+
+	memset(eeMem, 0xff, sizeof(eeMem));
+	eeFile = fopen(name, "r+b");
+	if (eeFile) {
+		if (fread(eeMem, 1, sizeof(eeMem), eeFile) != sizeof(eeMem)) {
+			fprintf(stderr, "%s: short EEPROM image\n", name);
+		}
+	} else if ((eeFile = fopen(name, "w+b")) != 0) {
+		fwrite(eeMem, 1, sizeof(eeMem), eeFile);
+		fflush(eeFile);
+	} else {
+		fprintf(stderr, "%s: %s, EEPROM not kept\n", name, strerror(errno));
+	}
+}
+
+static void eeProgram(uint16_t addr, uint8_t v) {
+	addr &= E2END;
+	eeMem[addr] = v;
+	if (eeFile) {
+		fseek(eeFile, addr, SEEK_SET);
+		fputc(v, eeFile);
+		fflush(eeFile);
+	}
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+	return eeMem[(uintptr_t)addr & E2END];
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		((uint8_t *)dst)[i] = eeprom_read_byte((const uint8_t *)src + i);
+	}
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value) {
+	eeProgram((uintptr_t)addr, value);
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		eeprom_write_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+	}
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value) {
+	if (eeprom_read_byte(addr) != value) {
+		eeprom_write_byte(addr, value);
+	}
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		eeprom_update_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+	}
+}
+
+/*
+ * A write started through EECR is done by the next service(), then
+ * EE_READY fires for as long as EERIE is set.
+ */
+static void eeService() {
+	if (EECR & _BV(EEPE)) {
+		eeProgram(EEAR, EEDR);
+		EECR &= ~(_BV(EEPE) | _BV(EEMPE));
+	}
+	if ((EECR & _BV(EERIE)) && EE_READY_vect) {
+		EE_READY_vect();
+	}
+}
+
+/***********************************************
+ * UART
+ ***********************************************/
+#define RX_BUF	64
+
+HardwareSerial Serial;
+
+static int		serIn = -1;
+static int		serOut = -1;
+static bool		serEof;
+static uint8_t	rxBuf[RX_BUF];
+static uint8_t	rxHead;
+static uint8_t	rxCount;
+
+static void rawMode(int fd) {
+	struct termios t;
+	if (tcgetattr(fd, &t) == 0) {
+		cfmakeraw(&t);
+		tcsetattr(fd, TCSANOW, &t);
+	}
+}
+
+static void serOpen() {
+	const char *name = getenv("AQI_SERIAL");
+
+	if (!name || !strcmp(name, "-")) {
+		serIn = 0;
+		serOut = 1;
+	} else if (!strcmp(name, "pty")) {
+		int fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if (fd < 0 || grantpt(fd) || unlockpt(fd)) {
+			perror("pty");
+			exit(1);
+		}
+		// keep the slave open so the master never sees a hangup
+		int slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+		if (slave >= 0) {
+			rawMode(slave);
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		fprintf(stderr, "serial on %s\n", ptsname(fd));
+		serIn = serOut = fd;
+	} else {
+		int fd = open(name, O_RDWR | O_NOCTTY);
+		if (fd < 0) {
+			perror(name);
+			exit(1);
+		}
+		if (isatty(fd)) {
+			rawMode(fd);
+		}
+		serIn = serOut = fd;
+	}
+}
+
+/*
+ * Pull in whatever arrived, without blocking.
+ */
+static void rxFill() {
+	if (serEof || serIn < 0 || rxCount == RX_BUF)
+		return;
+
+	struct pollfd p = { serIn, POLLIN, 0 };
+	if (poll(&p, 1, 0) <= 0 || !(p.revents & (POLLIN | POLLHUP)))
+		return;
+
+	uint8_t tmp[RX_BUF];
+	ssize_t n = ::read(serIn, tmp, RX_BUF - rxCount);
+	if (n == 0 && serIn == 0) {
+		serEof = true;	// input script is over, keep running
+	}
+	for (ssize_t i = 0; i < n; i++) {
+		rxBuf[(rxHead + rxCount++) % RX_BUF] = tmp[i];
+	}
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+	(void)baud;
+}
+
+void HardwareSerial::end() {
+}
+
+int HardwareSerial::available() {
+	rxFill();
+	return rxCount;
+}
+
+int HardwareSerial::read() {
+	rxFill();
+	if (!rxCount)
+		return -1;
+
+	uint8_t c = rxBuf[rxHead];
+	rxHead = (rxHead + 1) % RX_BUF;
+	rxCount--;
+	return c;
+}
+
+int HardwareSerial::peek() {
+	rxFill();
+	return rxCount ? rxBuf[rxHead] : -1;
+}
+
+void HardwareSerial::flush() {
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+/*
+ * Nobody listening on the pty drops the bytes, as on the real UART.
+ */
+size_t HardwareSerial::write(const uint8_t *buf, size_t n) {
+	size_t r = 0;
+	while (serOut >= 0 && r < n) {
+		ssize_t w = ::write(serOut, buf + r, n - r);
+		if (w <= 0) {
+			if (w < 0 && errno == EINTR)
+				continue;
+			break;
+		}
+		r += w;
+	}
+	return n;
+}
+
+/***********************************************
+ * avr-libc
+ ***********************************************/
+char *dtostrf(double val, signed char width, unsigned char prec, char *s) {
+	sprintf(s, "%*.*f", width, prec, val);
+	return s;
+}
+
+/***********************************************
+ * Setup
+ ***********************************************/
+static double envNum(const char *name, double def) {
+	const char *v = getenv(name);
+	return v ? strtod(v, 0) : def;
+}
+
+void halBegin() {
+	speed = envNum("AQI_SPEED", 1.0);
+	loopUs = envNum("AQI_LOOP_US", 100);
+	runUs = envNum("AQI_RUN_MS", 0) * 1000.0;
+	wallStart = wallMicros();
+
+	for (uint8_t i = 0; i < HAL_PINS; i++) {
+		pinLevel[i] = HIGH;
+	}
+
+	eeOpen();
+	serOpen();
+}
+
+static void service() {
+	eeService();
+	LiquidCrystal::service();
+}
+
+void halService() {
+	service();
+
+	if (speed <= 0.0) {
+		spent += loopUs;
+	} else if (loopUs) {
+		usleep((useconds_t)(loopUs / speed));
+	}
+}
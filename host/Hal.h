@@ -0,0 +1,54 @@
+/*
+ * Hal.h
+ *
+ *  Host side of the Arduino stand-ins. Everything is set up from the
+ *  environment by halBegin():
+ *
+ *  AQI_SPEED	simulated time runs this many times faster than the wall
+ *  			clock, 0 = virtual time that only moves when the sketch
+ *  			spends it (delay(), halSpend(), one AQI_LOOP_US per loop)
+ *  AQI_LOOP_US	time one pass of loop() takes, default 100
+ *  AQI_RUN_MS	stop after this much simulated time, default never
+ *  AQI_SERIAL	"-" (default) for stdin/stdout, "pty" for a new pseudo
+ *  			terminal (its name goes to stderr), anything else is a
+ *  			device or fifo to open
+ *  AQI_SD_DIR	directory standing in for the card, default "sd". The card
+ *  			is only there while the directory exists.
+ *  AQI_EEPROM	file holding the EEPROM, default "eeprom.bin"
+ *  AQI_LCD		set to print the LCD to stderr whenever it changed
+ *  AQI_TEMP, AQI_HUMI	what the DHT22 reads, default 22.5 C and 45 %RH
+ *  AQI_DSM		DSM501 pulse trains, see DsmSim.h for the settings. Without
+ *  			it the DSM501 pins stay high.
+ */
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <stdint.h>
+
+/*
+ * Level of an input pin at a point in simulated time. Returns -1 to fall
+ * back to the level set with halSetPin().
+ */
+typedef int (*HalPinSource)(uint8_t pin, uint64_t us);
+
+void halBegin();
+
+// one pass of the main loop is over, run pending interrupts
+void halService();
+
+// whether AQI_RUN_MS is used up
+bool halDone();
+
+// a blocking driver keeps the CPU this long
+void halSpend(uint32_t us);
+
+uint64_t halMicros();
+
+// same as AQI_SPEED, for tools that do not call halBegin(); time restarts at 0
+void halSetSpeed(double speed);
+
+void halSetPin(uint8_t pin, uint8_t level);
+void halSetPinSource(HalPinSource src);
+
+#endif /* HAL_H_ */
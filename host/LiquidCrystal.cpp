@@ -0,0 +1,99 @@
+/*
+ * LiquidCrystal.cpp
+ *
+ *  See LiquidCrystal.h. Writes past the end of a row are dropped, which
+ *  is what a 1602 shows with the cursor in the hidden part of the DDRAM.
+ */
+
+#include "LiquidCrystal.h"
+#include "Hal.h"
+
+/* a HD44780 write takes about 40 us plus the 4-bit bus overhead */
+#define LCD_WRITE_US	50u
+
+static LiquidCrystal *screen;
+static bool dirty;
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t en,
+		uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+	(void)rs; (void)rw; (void)en;
+	(void)d4; (void)d5; (void)d6; (void)d7;
+	init();
+}
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t en,
+		uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+	(void)rs; (void)en;
+	(void)d4; (void)d5; (void)d6; (void)d7;
+	init();
+}
+
+void LiquidCrystal::init() {
+	_cols = 16;
+	_rows = 2;
+	_col = _row = 0;
+	memset(_screen, 0, sizeof(_screen));
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows) {
+	_cols = cols > LCD_COLS_MAX ? LCD_COLS_MAX : cols;
+	_rows = rows > LCD_ROWS_MAX ? LCD_ROWS_MAX : rows;
+	screen = this;
+	clear();
+}
+
+void LiquidCrystal::clear() {
+	for (uint8_t r = 0; r < LCD_ROWS_MAX; r++) {
+		memset(_screen[r], ' ', _cols);
+		_screen[r][_cols] = 0;
+	}
+	home();
+	dirty = true;
+	halSpend(2000);
+}
+
+void LiquidCrystal::home() {
+	_col = _row = 0;
+}
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row) {
+	_col = col;
+	_row = row < _rows ? row : _rows - 1;
+	halSpend(LCD_WRITE_US);
+}
+
+size_t LiquidCrystal::write(uint8_t c) {
+	halSpend(LCD_WRITE_US);
+	if (_col < _cols) {
+		_screen[_row][_col] = c;
+		dirty = true;
+	}
+	_col++;
+	return 1;
+}
+
+const char *LiquidCrystal::row(uint8_t r) const {
+	return _screen[r < _rows ? r : 0];
+}
+
+void LiquidCrystal::service() {
+	static int show = -1;
+	static char shown[sizeof(screen->_screen)];
+
+	if (show < 0) {
+		show = getenv("AQI_LCD") != 0;
+	}
+	if (!show || !dirty || !screen)
+		return;
+
+	dirty = false;
+	if (!memcmp(shown, screen->_screen, sizeof(shown)))
+		return;
+	memcpy(shown, screen->_screen, sizeof(shown));
+
+	fprintf(stderr, "[%8lu] LCD", millis());
+	for (uint8_t r = 0; r < screen->_rows; r++) {
+		fprintf(stderr, " |%s|", screen->_screen[r]);
+	}
+	fputc('\n', stderr);
+}
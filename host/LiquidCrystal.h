@@ -0,0 +1,51 @@
+/*
+ * LiquidCrystal.h
+ *
+ *  Host character LCD. The screen is kept in memory and, with AQI_LCD set,
+ *  printed to stderr whenever it changed.
+ */
+
+#ifndef LIQUIDCRYSTAL_H_
+#define LIQUIDCRYSTAL_H_
+
+#include "Arduino.h"
+
+#define LCD_COLS_MAX	20
+#define LCD_ROWS_MAX	4
+
+class LiquidCrystal : public Print {
+public:
+	LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t en,
+			uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+	LiquidCrystal(uint8_t rs, uint8_t en,
+			uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+
+	void begin(uint8_t cols, uint8_t rows);
+	void clear();
+	void home();
+	void setCursor(uint8_t col, uint8_t row);
+	void autoscroll() {}
+	void noAutoscroll() {}
+	void display() {}
+	void noDisplay() {}
+
+	virtual size_t write(uint8_t c);
+	using Print::write;
+
+	// what is on the screen, one row
+	const char *row(uint8_t r) const;
+
+	// called by halService()
+	static void service();
+
+private:
+	void init();
+
+	uint8_t _cols;
+	uint8_t _rows;
+	uint8_t _col;
+	uint8_t _row;
+	char _screen[LCD_ROWS_MAX][LCD_COLS_MAX + 1];
+};
+
+#endif /* LIQUIDCRYSTAL_H_ */
@@ -0,0 +1,164 @@
+/*
+ * Print.cpp
+ *
+ *  Same output as the Arduino 1.0 Print class, number formatting included.
+ */
+
+#include "Arduino.h"
+
+size_t Print::write(const uint8_t *buf, size_t n) {
+	size_t r = 0;
+	while (n--) {
+		r += write(*buf++);
+	}
+	return r;
+}
+
+size_t Print::print(const __FlashStringHelper *s) {
+	return write((const char *)s);
+}
+
+size_t Print::print(const char s[]) {
+	return write(s);
+}
+
+size_t Print::print(char c) {
+	return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base) {
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base) {
+	return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base) {
+	if (base == 0)
+		return write((uint8_t)n);
+
+	if (base == 10 && n < 0) {
+		size_t r = print('-');
+		return r + printNumber(-(unsigned long)n, 10);
+	}
+	return printNumber((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+	if (base == 0)
+		return write((uint8_t)n);
+	return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {
+	return printFloat(n, digits);
+}
+
+size_t Print::println(const __FlashStringHelper *s) {
+	size_t r = print(s);
+	return r + println();
+}
+
+size_t Print::println(const char s[]) {
+	size_t r = print(s);
+	return r + println();
+}
+
+size_t Print::println(char c) {
+	size_t r = print(c);
+	return r + println();
+}
+
+size_t Print::println(unsigned char n, int base) {
+	size_t r = print(n, base);
+	return r + println();
+}
+
+size_t Print::println(int n, int base) {
+	size_t r = print(n, base);
+	return r + println();
+}
+
+size_t Print::println(unsigned int n, int base) {
+	size_t r = print(n, base);
+	return r + println();
+}
+
+size_t Print::println(long n, int base) {
+	size_t r = print(n, base);
+	return r + println();
+}
+
+size_t Print::println(unsigned long n, int base) {
+	size_t r = print(n, base);
+	return r + println();
+}
+
+size_t Print::println(double n, int digits) {
+	size_t r = print(n, digits);
+	return r + println();
+}
+
+size_t Print::println() {
+	return write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+	char buf[8 * sizeof(long) + 1];
+	char *s = &buf[sizeof(buf) - 1];
+
+	*s = 0;
+	if (base < 2) {
+		base = 10;
+	}
+	do {
+		unsigned long m = n;
+		n /= base;
+		char c = m - base * n;
+		*--s = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+
+	return write(s);
+}
+
+size_t Print::printFloat(double n, uint8_t digits) {
+	size_t r = 0;
+
+	if (isnan(n))
+		return print("nan");
+	if (isinf(n))
+		return print("inf");
+	if (n > 4294967040.0 || n < -4294967040.0)
+		return print("ovf");
+
+	if (n < 0.0) {
+		r += print('-');
+		n = -n;
+	}
+
+	double rounding = 0.5;
+	for (uint8_t i = 0; i < digits; i++) {
+		rounding /= 10.0;
+	}
+	n += rounding;
+
+	unsigned long whole = (unsigned long)n;
+	double rest = n - (double)whole;
+	r += print(whole);
+
+	if (digits > 0) {
+		r += print('.');
+	}
+	while (digits-- > 0) {
+		rest *= 10.0;
+		int d = (int)rest;
+		r += print(d);
+		rest -= d;
+	}
+	return r;
+}
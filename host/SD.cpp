@@ -0,0 +1,171 @@
+/*
+ * SD.cpp
+ *
+ *  See SD.h.
+ */
+
+#include "SD.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+SDClass SD;
+
+static const char *sdDir() {
+	const char *d = getenv("AQI_SD_DIR");
+	return d ? d : "sd";
+}
+
+static bool sdPresent() {
+	struct stat st;
+	return stat(sdDir(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void sdPath(char *buf, size_t n, const char *path) {
+	snprintf(buf, n, "%s/%s", sdDir(), path);
+}
+
+
+File::File() : _f(0), _mode(0) {
+	_name[0] = 0;
+}
+
+size_t File::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t n) {
+	if (!_f) {
+		setWriteError();
+		return 0;
+	}
+	// also switches from reading to writing
+	fseek(_f, 0, (_mode & O_APPEND) ? SEEK_END : SEEK_CUR);
+	size_t r = fwrite(buf, 1, n, _f);
+	if (r != n) {
+		setWriteError();
+	}
+	return r;
+}
+
+int File::available() {
+	if (!_f)
+		return 0;
+	uint32_t n = size() - position();
+	return n > 0x7fff ? 0x7fff : n;
+}
+
+int File::read() {
+	uint8_t c;
+	return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+	if (!_f)
+		return -1;
+	int c = fgetc(_f);
+	if (c != EOF) {
+		ungetc(c, _f);
+	}
+	return c == EOF ? -1 : c;
+}
+
+void File::flush() {
+	if (_f) {
+		fflush(_f);
+	}
+}
+
+int File::read(void *buf, uint16_t n) {
+	if (!_f)
+		return -1;
+	fseek(_f, 0, SEEK_CUR);	// switching from writing to reading
+	return fread(buf, 1, n, _f);
+}
+
+bool File::seek(uint32_t pos) {
+	return _f && pos <= size() && fseek(_f, pos, SEEK_SET) == 0;
+}
+
+uint32_t File::position() {
+	return _f ? ftell(_f) : 0;
+}
+
+uint32_t File::size() {
+	if (!_f)
+		return 0;
+	fflush(_f);
+	struct stat st;
+	return fstat(fileno(_f), &st) == 0 ? st.st_size : 0;
+}
+
+void File::close() {
+	if (_f) {
+		fclose(_f);
+		_f = 0;
+	}
+}
+
+const char *File::name() {
+	return _name;
+}
+
+File::operator bool() {
+	return _f != 0;
+}
+
+
+bool SDClass::begin(uint8_t csPin) {
+	(void)csPin;
+	_ok = sdPresent();
+	return _ok;
+}
+
+void SDClass::end() {
+	_ok = false;
+}
+
+/*
+ * Writing creates the file and starts at its end, but the file can still
+ * be read and seeked like with the Arduino library.
+ */
+File SDClass::open(const char *path, uint8_t mode) {
+	File file;
+	char p[256];
+
+	if (!_ok || !sdPresent())
+		return file;
+
+	sdPath(p, sizeof(p), path);
+	file._mode = mode;
+	if (mode & O_WRITE) {
+		file._f = fopen(p, "r+b");
+		if (!file._f) {
+			file._f = fopen(p, "w+b");
+		}
+		if (file._f) {
+			fseek(file._f, 0, SEEK_END);
+		}
+	} else {
+		file._f = fopen(p, "rb");
+	}
+
+	const char *n = strrchr(path, '/');
+	strncpy(file._name, n ? n + 1 : path, sizeof(file._name) - 1);
+	file._name[sizeof(file._name) - 1] = 0;
+	return file;
+}
+
+bool SDClass::exists(const char *path) {
+	char p[256];
+	struct stat st;
+
+	sdPath(p, sizeof(p), path);
+	return _ok && stat(p, &st) == 0;
+}
+
+bool SDClass::remove(const char *path) {
+	char p[256];
+
+	sdPath(p, sizeof(p), path);
+	return _ok && unlink(p) == 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * SD.h
+ *
+ *  Host SD card: files live in the directory named by AQI_SD_DIR, and the
+ *  card is only present while that directory exists. Like the Arduino
+ *  library, a File is a handle that has to be closed explicitly.
+ */
+
+#ifndef SD_H_
+#define SD_H_
+
+#include "Arduino.h"
+
+// open() modes, the SdFat flags the SD library passes on
+#define O_READ		0x01
+#define O_WRITE		0x02
+#define O_APPEND	0x04	// every write goes to the end
+#define O_CREAT		0x10
+
+#define FILE_READ	O_READ
+#define FILE_WRITE	(O_READ | O_WRITE | O_CREAT | O_APPEND)
+
+class File : public Stream {
+public:
+	File();
+
+	virtual size_t write(uint8_t c);
+	virtual size_t write(const uint8_t *buf, size_t n);
+	using Print::write;
+
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+	virtual void flush();
+	int read(void *buf, uint16_t n);
+
+	bool seek(uint32_t pos);
+	uint32_t position();
+	uint32_t size();
+	void close();
+	const char *name();
+
+	operator bool();
+
+private:
+	friend class SDClass;
+
+	FILE *_f;
+	uint8_t _mode;
+	char _name[13];
+};
+
+class SDClass {
+public:
+	bool begin(uint8_t csPin = SS);
+	void end();
+
+	File open(const char *path, uint8_t mode = FILE_READ);
+	bool exists(const char *path);
+	bool remove(const char *path);
+
+private:
+	bool _ok;
+};
+
+extern SDClass SD;
+
+#endif /* SD_H_ */
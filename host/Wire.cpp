@@ -0,0 +1,184 @@
+/*
+ * Wire.cpp
+ *
+ *  Host I2C bus with a DS1307 at 0x68. The clock starts at the local wall
+ *  clock time and then follows simulated time; its 56 bytes of RAM live as
+ *  long as the process. Hours are kept the way DS1307.cpp writes them,
+ *  24 h with bit 6 set.
+ */
+
+#include "Wire.h"
+#include "Hal.h"
+#include <time.h>
+
+TwoWire Wire;
+
+#define RTC_ADDR	0x68
+#define RTC_REGS	64
+
+static uint8_t rtcReg[RTC_REGS];
+static uint8_t rtcPtr;
+static uint32_t rtcBase;		// seconds since 2000-01-01 at rtcBaseUs
+static uint64_t rtcBaseUs;
+static bool rtcStarted;
+
+static uint8_t bcd(int v) {
+	return ((v / 10) << 4) | (v % 10);
+}
+
+static int unbcd(uint8_t v) {
+	return (v >> 4) * 10 + (v & 0xf);
+}
+
+static int monthDays(int y, int M) {
+	static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	return (M == 2 && (y & 3) == 0) ? 29 : days[M - 1];
+}
+
+static uint32_t toEpoch(int y, int M, int d, int h, int m, int s) {
+	uint32_t days = y * 365u + (y + 3) / 4;
+	for (int i = 1; i < M; i++) {
+		days += monthDays(y, i);
+	}
+	days += d - 1;
+	return ((days * 24ul + h) * 60ul + m) * 60ul + s;
+}
+
+static void rtcStart() {
+	time_t t = time(0);
+	struct tm tm;
+	localtime_r(&t, &tm);
+
+	rtcBase = toEpoch(tm.tm_year % 100, tm.tm_mon + 1, tm.tm_mday,
+			tm.tm_hour, tm.tm_min, tm.tm_sec);
+	rtcBaseUs = halMicros();
+	rtcReg[2] = 0x40;
+	rtcStarted = true;
+}
+
+/*
+ * Bring registers 0-6 up to the current simulated time.
+ */
+static void rtcLatch() {
+	uint32_t t = rtcBase + (uint32_t)((halMicros() - rtcBaseUs) / 1000000u);
+
+	rtcReg[0] = (rtcReg[0] & 0x80) | bcd(t % 60);
+	t /= 60;
+	rtcReg[1] = bcd(t % 60);
+	t /= 60;
+	rtcReg[2] = (rtcReg[2] & 0x40) | bcd(t % 24);
+	t /= 24;
+	rtcReg[3] = (t + 6) % 7 + 1;	// 2000-01-01 was a Saturday
+
+	int y = 0;
+	while (t >= (uint32_t)((y & 3) ? 365 : 366)) {
+		t -= (y & 3) ? 365 : 366;
+		y++;
+	}
+	int M = 1;
+	while (t >= (uint32_t)monthDays(y, M)) {
+		t -= monthDays(y, M);
+		M++;
+	}
+	rtcReg[4] = bcd(t + 1);
+	rtcReg[5] = bcd(M);
+	rtcReg[6] = bcd(y);
+}
+
+/*
+ * Writing any time register restarts the clock from registers 0-6.
+ */
+static void rtcWrite(const uint8_t *buf, uint8_t n) {
+	if (!n)
+		return;
+
+	rtcLatch();
+	rtcPtr = buf[0] % RTC_REGS;
+
+	bool time = false;
+	for (uint8_t i = 1; i < n; i++) {
+		if (rtcPtr < 7)
+			time = true;
+		rtcReg[rtcPtr] = buf[i];
+		rtcPtr = (rtcPtr + 1) % RTC_REGS;
+	}
+
+	if (time) {
+		rtcBase = toEpoch(unbcd(rtcReg[6]), unbcd(rtcReg[5] & 0x1f),
+				unbcd(rtcReg[4] & 0x3f), unbcd(rtcReg[2] & 0x3f),
+				unbcd(rtcReg[1] & 0x7f), unbcd(rtcReg[0] & 0x7f));
+		rtcBaseUs = halMicros();
+	}
+}
+
+
+void TwoWire::begin() {
+	if (!rtcStarted) {
+		rtcStart();
+	}
+	_txLen = 0;
+	_rxLen = _rxPos = 0;
+}
+
+void TwoWire::beginTransmission(uint8_t addr) {
+	_addr = addr;
+	_txLen = 0;
+}
+
+/*
+ * 0 on success, 2 when nobody acknowledged the address.
+ */
+uint8_t TwoWire::endTransmission() {
+	if (_addr != RTC_ADDR)
+		return 2;
+
+	rtcWrite(_tx, _txLen);
+	_txLen = 0;
+	return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t n) {
+	_rxLen = _rxPos = 0;
+	if (addr != RTC_ADDR)
+		return 0;
+
+	if (n > BUFFER_LENGTH) {
+		n = BUFFER_LENGTH;
+	}
+
+	rtcLatch();
+	for (uint8_t i = 0; i < n; i++) {
+		_rx[i] = rtcReg[rtcPtr];
+		rtcPtr = (rtcPtr + 1) % RTC_REGS;
+	}
+	_rxLen = n;
+	return n;
+}
+
+size_t TwoWire::write(uint8_t c) {
+	if (_txLen >= BUFFER_LENGTH)
+		return 0;
+
+	_tx[_txLen++] = c;
+	return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buf, size_t n) {
+	size_t r = 0;
+	while (n-- && write(*buf++)) {
+		r++;
+	}
+	return r;
+}
+
+int TwoWire::available() {
+	return _rxLen - _rxPos;
+}
+
+int TwoWire::read() {
+	return _rxPos < _rxLen ? _rx[_rxPos++] : -1;
+}
+
+int TwoWire::peek() {
+	return _rxPos < _rxLen ? _rx[_rxPos] : -1;
+}
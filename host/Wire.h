@@ -0,0 +1,52 @@
+/*
+ * Wire.h
+ *
+ *  Host I2C bus. The only device on it is a simulated DS1307, see Wire.cpp.
+ */
+
+#ifndef WIRE_H_
+#define WIRE_H_
+
+#include "Arduino.h"
+
+#define BUFFER_LENGTH	32
+
+class TwoWire : public Stream {
+public:
+	void begin();
+
+	void beginTransmission(uint8_t addr);
+	void beginTransmission(int addr) {
+		beginTransmission((uint8_t)addr);
+	}
+	uint8_t endTransmission();
+
+	uint8_t requestFrom(uint8_t addr, uint8_t n);
+	uint8_t requestFrom(int addr, int n) {
+		return requestFrom((uint8_t)addr, (uint8_t)n);
+	}
+
+	virtual size_t write(uint8_t c);
+	virtual size_t write(const uint8_t *buf, size_t n);
+	size_t write(int c) {
+		return write((uint8_t)c);
+	}
+	using Print::write;
+
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+	virtual void flush() {}
+
+private:
+	uint8_t _addr;
+	uint8_t _tx[BUFFER_LENGTH];
+	uint8_t _txLen;
+	uint8_t _rx[BUFFER_LENGTH];
+	uint8_t _rxLen;
+	uint8_t _rxPos;
+};
+
+extern TwoWire Wire;
+
+#endif /* WIRE_H_ */
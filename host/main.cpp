@@ -0,0 +1,29 @@
+/*
+ * main.cpp
+ *
+ *  Runs the sketch on the host, the way the Arduino core's main() does.
+ */
+
+#include "AirQ.h"
+#include "Hal.h"
+#include "DsmSim.h"
+#include "DSM501.h"
+
+int main() {
+	halBegin();
+
+	static DsmSim dsm;
+	const char *s = getenv("AQI_DSM");
+	if (s) {
+		if (!dsm.config(s) || !dsm.begin(PM10_PIN, PM25_PIN))
+			return 2;
+		dsm.attach();
+	}
+
+	setup();
+	while (!halDone()) {
+		loop();
+		halService();
+	}
+	return 0;
+}
@@ -0,0 +1,20 @@
+/*
+ * avr/eeprom.h
+ *
+ *  1 KB of EEPROM kept in a file, see Hal.h.
+ */
+
+#ifndef AVR_EEPROM_H_
+#define AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#endif /* AVR_EEPROM_H_ */
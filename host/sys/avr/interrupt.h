@@ -0,0 +1,16 @@
+/*
+ * avr/interrupt.h
+ *
+ *  Handlers run from halService() and never preempt the sketch, so there
+ *  is nothing to lock against.
+ */
+
+#ifndef AVR_INTERRUPT_H_
+#define AVR_INTERRUPT_H_
+
+#define ISR(vector, ...)	extern "C" void vector(void); void vector(void)
+
+#define cli()	((void)0)
+#define sei()	((void)0)
+
+#endif /* AVR_INTERRUPT_H_ */
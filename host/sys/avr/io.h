@@ -0,0 +1,30 @@
+/*
+ * avr/io.h
+ *
+ *  The registers the sketch touches directly, as plain variables. Hal.cpp
+ *  acts on them between two loop() calls, see halService().
+ */
+
+#ifndef AVR_IO_H_
+#define AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit)	(1u << (bit))
+
+/* EEPROM */
+extern volatile uint8_t EECR;
+extern volatile uint8_t EEDR;
+extern volatile uint16_t EEAR;
+
+#define EERIE		3
+#define EEMPE		2
+#define EEPE		1
+#define EERE		0
+
+#define E2END		0x3ff
+
+/* interrupt vectors are plain C functions, called by Hal.cpp */
+#define EE_READY_vect	halEeReadyVect
+
+#endif /* AVR_IO_H_ */
@@ -0,0 +1,24 @@
+/*
+ * avr/pgmspace.h
+ *
+ *  Flash and RAM are one address space on the host.
+ */
+
+#ifndef AVR_PGMSPACE_H_
+#define AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)				(s)
+
+#define pgm_read_byte(p)	(*(const uint8_t *)(p))
+#define pgm_read_word(p)	(*(const uint16_t *)(p))
+#define pgm_read_dword(p)	(*(const uint32_t *)(p))
+
+#define memcpy_P			memcpy
+#define strlen_P			strlen
+#define strcpy_P			strcpy
+
+#endif /* AVR_PGMSPACE_H_ */
@@ -0,0 +1,16 @@
+/*
+ * avr/wdt.h
+ *
+ *  No watchdog on the host.
+ */
+
+#ifndef AVR_WDT_H_
+#define AVR_WDT_H_
+
+#define WDTO_1S			6
+
+#define wdt_reset()		((void)0)
+#define wdt_enable(t)	((void)0)
+#define wdt_disable()	((void)0)
+
+#endif /* AVR_WDT_H_ */
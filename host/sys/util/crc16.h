@@ -0,0 +1,20 @@
+/*
+ * util/crc16.h
+ *
+ *  Same algorithm as the avr-libc version, in C.
+ */
+
+#ifndef UTIL_CRC16_H_
+#define UTIL_CRC16_H_
+
+#include <stdint.h>
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+	data ^= (uint8_t)(crc & 0xff);
+	data ^= data << 4;
+
+	return ((((uint16_t)data << 8) | (crc >> 8)) ^
+		(uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+#endif /* UTIL_CRC16_H_ */
@@ -0,0 +1,14 @@
+/*
+ * util/delay.h
+ */
+
+#ifndef UTIL_DELAY_H_
+#define UTIL_DELAY_H_
+
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+#define _delay_ms(ms)	delay(ms)
+#define _delay_us(us)	delayMicroseconds(us)
+
+#endif /* UTIL_DELAY_H_ */
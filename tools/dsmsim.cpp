@@ -0,0 +1,190 @@
+/*
+ * dsmsim.cpp
+ *
+ *  Runs DSM501 against the pulse train simulator in virtual time and
+ *  compares what it reports with the ground truth, to tune the filtering.
+ *
+ *  usage: dsmsim [key=value[,key=value...]]...
+ *
+ *  days, hours		simulated time, default 1 day
+ *  loop			main loop period in us, an edge is seen up to this late,
+ *  				default 1000
+ *  idle			ms between update() calls with no edge in between,
+ *  				default 50
+ *  csv				write one line per window to this file
+ *
+ *  and the simulator settings, see host/DsmSim.h. The error is reported in
+ *  percent points of low ratio, over the windows after the first
+ *  SAF_WIN_MAX when the sliding filter is full.
+ */
+
+#include "DSM501.h"
+#include "DsmSim.h"
+#include "Hal.h"
+#include <time.h>
+
+struct Stats {
+	double sum;
+	double sumSq;
+	double absSum;
+	double max;
+	unsigned n;
+};
+
+static void addError(Stats &s, double err) {
+	s.sum += err;
+	s.sumSq += err * err;
+	s.absSum += fabs(err);
+	if (fabs(err) > s.max) {
+		s.max = fabs(err);
+	}
+	s.n++;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: dsmsim [key=value[,key=value...]]...\n"
+			"  days, hours, loop, idle, csv, and the DsmSim settings:\n"
+			"  occ10, occ25, pulse, jitter, bounce, long, swing, period,\n"
+			"  seed, trace, record\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	DsmSim sim;
+	double hours = 24.0;
+	uint32_t loopUs = 1000;
+	uint32_t idleUs = 50000;
+	const char *csvName = 0;
+
+	for (int i = 1; i < argc; i++) {
+		char *buf = strdup(argv[i]), *save;
+		for (char *kv = strtok_r(buf, ",", &save); kv; kv = strtok_r(0, ",", &save)) {
+			char *v = strchr(kv, '=');
+			if (!v)
+				usage();
+
+			if (!strncmp(kv, "days=", 5)) {
+				hours = atof(v + 1) * 24.0;
+			} else if (!strncmp(kv, "hours=", 6)) {
+				hours = atof(v + 1);
+			} else if (!strncmp(kv, "loop=", 5)) {
+				loopUs = strtoul(v + 1, 0, 0);
+			} else if (!strncmp(kv, "idle=", 5)) {
+				idleUs = strtoul(v + 1, 0, 0) * 1000u;
+			} else if (!strncmp(kv, "csv=", 4)) {
+				csvName = strdup(v + 1);
+			} else if (!sim.config(kv)) {
+				usage();
+			}
+		}
+		free(buf);
+	}
+
+	FILE *csv = 0;
+	if (csvName) {
+		csv = fopen(csvName, "w");
+		if (!csv) {
+			perror(csvName);
+			return 1;
+		}
+		fprintf(csv, "window,t_s,true10,dsm10,true25,dsm25\n");
+	}
+
+	halSetSpeed(0);
+	if (!sim.begin(PM10_PIN, PM25_PIN))
+		return 1;
+	sim.attach();
+
+	DSM501 dsm(PM10_PIN, PM25_PIN);
+	dsm.begin();
+
+	/* trailing SAF_WIN_MAX windows of ground truth, as DSM501 keeps them */
+	uint64_t truth[DSMSIM_CHANNELS][SAF_WIN_MAX];
+	uint64_t span[SAF_WIN_MAX];
+	uint64_t lastLow[DSMSIM_CHANNELS] = { 0, 0 };
+	uint64_t lastClose = 0;
+	uint16_t windows = dsm.getWindows();
+	unsigned closed = 0;
+	Stats stats[DSMSIM_CHANNELS];
+	memset(stats, 0, sizeof(stats));
+
+	uint64_t end = (uint64_t)(hours * 3600e6);
+	uint64_t latency = 0x2545f491;
+	clock_t started = clock();
+
+	for (uint64_t now = halMicros(); now < end; now = halMicros()) {
+		/* the loop notices an edge somewhere within one pass */
+		uint64_t next = now + idleUs;
+		uint64_t edge = sim.nextEdge();
+		if (edge < next && loopUs) {
+			latency = latency * 6364136223846793005ull + 1442695040888963407ull;
+			next = edge + (latency >> 33) % loopUs;
+		}
+		if (next <= now) {
+			next = now + 1;
+		}
+		halSpend(next - now);
+		now = next;
+
+		dsm.update();
+		if (dsm.getWindows() == windows)
+			continue;
+		windows = dsm.getWindows();
+
+		uint8_t slot = closed % SAF_WIN_MAX;
+		span[slot] = now - lastClose;
+		lastClose = now;
+		for (uint8_t i = 0; i < DSMSIM_CHANNELS; i++) {
+			uint64_t low = sim.trueLow(i, now);
+			truth[i][slot] = low - lastLow[i];
+			lastLow[i] = low;
+		}
+		closed++;
+
+		uint8_t n = closed < SAF_WIN_MAX ? closed : SAF_WIN_MAX;
+		uint64_t total = 0;
+		for (uint8_t k = 0; k < n; k++) {
+			total += span[k];
+		}
+
+		double trueRatio[DSMSIM_CHANNELS], dsmRatio[DSMSIM_CHANNELS];
+		for (uint8_t i = 0; i < DSMSIM_CHANNELS; i++) {
+			uint64_t low = 0;
+			for (uint8_t k = 0; k < n; k++) {
+				low += truth[i][k];
+			}
+			trueRatio[i] = low * 100.0 / total;
+			dsmRatio[i] = dsm.getLowRatio(i) * dsm.getCoeff();
+			if (closed > SAF_WIN_MAX) {
+				addError(stats[i], dsmRatio[i] - trueRatio[i]);
+			}
+		}
+
+		if (csv) {
+			fprintf(csv, "%u,%.3f,%.4f,%.4f,%.4f,%.4f\n", closed, now / 1e6,
+					trueRatio[0], dsmRatio[0], trueRatio[1], dsmRatio[1]);
+		}
+	}
+	sim.end();
+	if (csv) {
+		fclose(csv);
+	}
+
+	uint64_t now = halMicros();
+	double cpu = (double)(clock() - started) / CLOCKS_PER_SEC;
+	printf("simulated %.1f h in %.2f s (%.0fx), %u windows\n",
+			now / 3600e6, cpu, cpu > 0.0 ? now / 1e6 / cpu : 0.0, closed);
+	printf("%-5s %8s %8s %8s %8s %8s %8s\n",
+			"pin", "true%", "raw%", "bias", "mae", "rmse", "max");
+
+	static const char *names[DSMSIM_CHANNELS] = { "PM10", "PM25" };
+	for (uint8_t i = 0; i < DSMSIM_CHANNELS; i++) {
+		Stats &s = stats[i];
+		double n = s.n ? s.n : 1;
+		printf("%-5s %8.4f %8.4f %8.4f %8.4f %8.4f %8.4f\n", names[i],
+				sim.trueLow(i, now) * 100.0 / now,
+				sim.rawLow(i, now) * 100.0 / now,
+				s.sum / n, s.absSum / n, sqrt(s.sumSq / n), s.max);
+	}
+	return 0;
+}